@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Benchmarks of the BoxIt server internals.
+# Links the server sources without its main().
+#
+#-------------------------------------------------
+
+QT       += core network
+
+QT       -= gui
+
+LIBS     += -larchive -lz -lzstd
+
+TARGET = boxit-benchmark
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+include(../boxit-server.pri)
@@ -0,0 +1,687 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QEventLoop>
+#include <QTimer>
+#include <iostream>
+#include "global.h"
+#include "db/packageset.h"
+#include "db/parallelgzip.h"
+#include "db/database.h"
+#include "db/commitscheduler.h"
+#include "db/repocache.h"
+#include "db/poolstore.h"
+#include "db/stringpool.h"
+#include "db/repo.h"
+#include "db/repodatabase.h"
+#include "db/status.h"
+
+using namespace std;
+
+
+
+void printHelp() {
+    cout << "\nboxit-benchmark COMMAND [ARGS]\n" << endl;
+    cout << "\tpackageset [PACKAGES]\t\tcommit planning of PACKAGES sync packages with PackageSet and with nested loops" << endl;
+    cout << "\tdatabase DB FILES [THREADS]\twrite the database DB and files database FILES with 1 and THREADS compression threads" << endl;
+    cout << "\tmemory [--no-intern]\t\tresident memory of the loaded package lists, package entries and databases" << endl;
+    cout << "\tsnapshot BRANCH\t\t\tclone BRANCH like a snapshot and copy it like before" << endl;
+    cout << "\tlocks A B THREADS [SECONDS]\tread-only database calls of THREADS threads without and with snapshots of the scratch branches A and B onto each other\n" << endl;
+    cout << "Commands other than packageset use the settings of the BoxIt server config." << endl;
+    cout << "Commands which initialize the repositories have to run while the server is stopped.\n" << endl;
+}
+
+
+
+void createPackageLists(const int count, QStringList & oldSyncList, QStringList & newSyncList, QStringList & overlayList) {
+    for (int i = 0; i < count; ++i) {
+        const QString oldPackage = QString("package%1-1.0-1-x86_64.pkg.tar.zst").arg(i);
+        const QString newPackage = QString("package%1-%2-1-x86_64.pkg.tar.zst").arg(i).arg((i % 10 == 0) ? "1.1" : "1.0");
+
+        // A tenth of the sync packages is updated by the new list
+        oldSyncList.append(oldPackage);
+        newSyncList.append(newPackage);
+
+        // Every 50th package is shadowed by an overlay package. Some of them are in the sync pool, too.
+        if (i % 500 == 0)
+            overlayList.append(newPackage);
+        else if (i % 50 == 0)
+            overlayList.append(QString("package%1-2.0-1-x86_64.pkg.tar.zst").arg(i));
+    }
+}
+
+
+
+// Commit planning as it was implemented before PackageSet
+void planCommitNaive(const QStringList & overlayList, const QStringList & oldSyncList, const QStringList & newSyncList, const QList<RepoDatabase::Entry> & dbEntries,
+                     QStringList & added, QStringList & removed, QStringList & packagesToRemove, QStringList & packagesToAdd) {
+    QList<Repo::Package> packages;
+
+    foreach (const QString package, overlayList) {
+        Repo::Package pkg;
+        pkg.file = package;
+        pkg.name = Global::getNameofPKG(package);
+        pkg.version = Global::getVersionofPKG(package);
+        pkg.link = Global::poolFilePath(BOXIT_OVERLAY_POOL, package);
+        pkg.isOverlayPackage = true;
+
+        packages.append(pkg);
+    }
+
+    foreach (const QString package, newSyncList) {
+        Repo::Package pkg;
+        pkg.file = package;
+        pkg.name = Global::getNameofPKG(package);
+        pkg.version = Global::getVersionofPKG(package);
+        pkg.link = Global::poolFilePath(BOXIT_SYNC_POOL, package);
+        pkg.isOverlayPackage = false;
+
+        bool found = false;
+        for (int i = 0; i < packages.size(); ++i) {
+            if (pkg.name == packages.at(i).name) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            packages.append(pkg);
+    }
+
+    foreach (const QString package, newSyncList) {
+        if (!oldSyncList.contains(package))
+            added.append(package);
+    }
+
+    foreach (const QString package, oldSyncList) {
+        if (!newSyncList.contains(package))
+            removed.append(package);
+    }
+
+    for (int i = 0; i < dbEntries.size(); ++i) {
+        const RepoDatabase::Entry *dbPackage = &dbEntries.at(i);
+        bool found = false;
+
+        for (int x = 0; x < packages.size(); ++x) {
+            const Repo::Package *package = &packages.at(x);
+
+            if (dbPackage->name == package->name && dbPackage->version == package->version) {
+                if (package->isOverlayPackage && newSyncList.contains(package->file)) {
+                    packagesToAdd.append(package->link);
+                    break;
+                }
+
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            packagesToRemove.append(dbPackage->name);
+    }
+
+    for (int i = 0; i < packages.size(); ++i) {
+        const Repo::Package *package = &packages.at(i);
+        bool found = false;
+
+        for (int x = 0; x < dbEntries.size(); ++x) {
+            if (package->name == dbEntries.at(x).name && package->version == dbEntries.at(x).version) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            packagesToAdd.append(package->link);
+    }
+
+    packagesToAdd.removeDuplicates();
+}
+
+
+
+// Commit planning of Repo::prepare() and Repo::updatePackageDatabase()
+void planCommit(const QStringList & overlayList, const QStringList & oldSyncList, const QStringList & newSyncList, const QList<RepoDatabase::Entry> & dbEntries,
+                QStringList & added, QStringList & removed, QStringList & packagesToRemove, QStringList & packagesToAdd) {
+    QList<Repo::Package> packages;
+
+    Repo::getPackages(overlayList, newSyncList, packages);
+
+    added = PackageSet::difference(newSyncList, oldSyncList);
+    removed = PackageSet::difference(oldSyncList, newSyncList);
+
+    Repo::getDatabaseChanges(dbEntries, packages, newSyncList, packagesToRemove, packagesToAdd);
+}
+
+
+
+int benchmarkPackageSet(const int count) {
+    QStringList oldSyncList, newSyncList, overlayList;
+    createPackageLists(count, oldSyncList, newSyncList, overlayList);
+
+    // The database holds the packages of the old lists
+    QList<Repo::Package> dbPackages;
+    QList<RepoDatabase::Entry> dbEntries;
+
+    Repo::getPackages(overlayList, oldSyncList, dbPackages);
+
+    for (int i = 0; i < dbPackages.size(); ++i) {
+        RepoDatabase::Entry entry;
+        entry.name = dbPackages.at(i).name;
+        entry.version = dbPackages.at(i).version;
+        entry.fileName = dbPackages.at(i).file;
+        dbEntries.append(entry);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList added, removed, packagesToRemove, packagesToAdd;
+    planCommitNaive(overlayList, oldSyncList, newSyncList, dbEntries, added, removed, packagesToRemove, packagesToAdd);
+
+    const qint64 naiveTime = timer.restart();
+
+    QStringList setAdded, setRemoved, setPackagesToRemove, setPackagesToAdd;
+    planCommit(overlayList, oldSyncList, newSyncList, dbEntries, setAdded, setRemoved, setPackagesToRemove, setPackagesToAdd);
+
+    const qint64 setTime = timer.elapsed();
+
+    packagesToRemove.sort();
+    packagesToAdd.sort();
+    setPackagesToRemove.sort();
+    setPackagesToAdd.sort();
+
+    if (added != setAdded || removed != setRemoved || packagesToRemove != setPackagesToRemove || packagesToAdd != setPackagesToAdd) {
+        cerr << "error: results differ!" << endl;
+        return 1;
+    }
+
+    cout << count << " sync packages, " << overlayList.size() << " overlay packages, "
+         << added.size() << " added, " << removed.size() << " removed, "
+         << packagesToAdd.size() << " database additions, " << packagesToRemove.size() << " database removals" << endl;
+    cout << "nested loops: " << naiveTime << " ms" << endl;
+    cout << "PackageSet: " << setTime << " ms" << endl;
+
+    return 0;
+}
+
+
+
+bool writeDatabase(RepoDatabase & database, const int threads, const QString dbPath, const QString filesDbPath, const QString oldFilesDbPath, qint64 & time) {
+    Global::Config config = Global::getConfig();
+    config.dbCompressionThreads = threads;
+    Global::setConfig(config);
+    ParallelGzip::init();
+
+    QFile::remove(dbPath);
+    QFile::remove(filesDbPath);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!database.write(dbPath, filesDbPath, oldFilesDbPath)) {
+        cerr << "error: " << database.lastError().toUtf8().data() << endl;
+        return false;
+    }
+
+    time = timer.elapsed();
+
+    return true;
+}
+
+
+
+int benchmarkDatabase(const QString dbPath, const QString filesDbPath, int threads) {
+    if (threads <= 0)
+        threads = qMax(1, QThread::idealThreadCount());
+
+    RepoDatabase database;
+
+    if (!database.read(dbPath)) {
+        cerr << "error: " << database.lastError().toUtf8().data() << endl;
+        return 1;
+    }
+
+    const QString cacheDir = QString(BOXIT_SESSION_TMP) + "/benchmark_files_cache";
+    const QString newDbPath = QString(BOXIT_SESSION_TMP) + "/benchmark.db";
+    const QString newFilesDbPath = QString(BOXIT_SESSION_TMP) + "/benchmark.files";
+    qint64 cacheTime, singleTime, parallelTime;
+
+    database.setFilesCacheDir(cacheDir);
+
+    // The first write fills the files cache from the published files database.
+    // The following writes only assemble and compress, like a commit does.
+    if (!writeDatabase(database, threads, newDbPath, newFilesDbPath, filesDbPath, cacheTime)
+            || !writeDatabase(database, 1, newDbPath, newFilesDbPath, filesDbPath, singleTime)
+            || !writeDatabase(database, threads, newDbPath, newFilesDbPath, filesDbPath, parallelTime)) {
+        Global::rmDir(cacheDir);
+        return 1;
+    }
+
+    // The written database has to contain every entry
+    RepoDatabase check;
+
+    if (!check.read(newDbPath) || check.getEntries().size() != database.getEntries().size()) {
+        cerr << "error: written database differs!" << endl;
+        Global::rmDir(cacheDir);
+        return 1;
+    }
+
+    cout << database.getEntries().size() << " packages, " << (Global::getConfig().zstdDatabases ? "zstd" : "gzip")
+         << " level " << Global::getConfig().dbCompressionLevel << ", "
+         << QFileInfo(newDbPath).size() << " + " << QFileInfo(newFilesDbPath).size() << " bytes" << endl;
+    cout << "files cache fill: " << cacheTime << " ms" << endl;
+    cout << "1 thread: " << singleTime << " ms" << endl;
+    cout << threads << " threads: " << parallelTime << " ms" << endl;
+
+    QFile::remove(newDbPath);
+    QFile::remove(newFilesDbPath);
+    Global::rmDir(cacheDir);
+
+    return 0;
+}
+
+
+
+bool initDatabase() {
+    CommitScheduler::init();
+    ParallelGzip::init();
+    RepoCache::init();
+
+    if (!PoolStore::init()) {
+        cerr << "error: failed to initialize pool object store!" << endl;
+        return false;
+    }
+
+    return Database::init();
+}
+
+
+
+int benchmarkMemory(const bool intern) {
+    QElapsedTimer timer;
+    const qint64 startMemory = Global::residentMemory();
+
+    StringPool::setEnabled(intern);
+    cout << "string interning " << (intern ? "enabled" : "disabled") << endl;
+
+    timer.start();
+
+    if (!initDatabase())
+        return 1;
+
+    cout << "init: " << timer.restart() << " ms, resident memory " << startMemory << " -> " << Global::residentMemory() << " kB" << endl;
+
+    // Load the package lists of all repositories. The metadata keeps them loaded.
+    const QString repoDir = Global::getConfig().repoDir;
+    QList<Repo::MetadataPtr> repos;
+    QStringList repoPaths;
+    int packages = 0;
+
+    foreach (const QString branchName, Database::getBranches()) {
+        QList<Repo::MetadataPtr> list;
+
+        if (!Database::getRepos(branchName, list)) {
+            cerr << "error: failed to read repositories of branch '" << branchName.toUtf8().data() << "'!" << endl;
+            return 1;
+        }
+
+        foreach (const Repo::MetadataPtr metadata, list)
+            repoPaths.append(repoDir + "/" + branchName + "/" + metadata->name + "/" + metadata->architecture);
+
+        repos.append(list);
+    }
+
+    foreach (const Repo::MetadataPtr metadata, repos)
+        packages += metadata->overlayPackages.size() + metadata->syncPackages.size();
+
+    cout << "package lists of " << repos.size() << " repositories with " << packages << " entries: " << timer.restart() << " ms, resident memory "
+         << Global::residentMemory() << " kB" << endl;
+
+    // Package entries of the commit planning
+    QList< QList<Repo::Package> > repoPackages;
+
+    foreach (const Repo::MetadataPtr metadata, repos) {
+        QList<Repo::Package> list;
+        Repo::getPackages(metadata->overlayPackages, metadata->syncPackages, list);
+        repoPackages.append(list);
+    }
+
+    cout << "package entries: " << timer.restart() << " ms, resident memory " << Global::residentMemory() << " kB" << endl;
+
+    // Package databases
+    QList<RepoDatabase> databases;
+    const QString dbEnding = Global::getConfig().zstdDatabases ? BOXIT_ZSTD_DB_ENDING : BOXIT_DB_ENDING;
+
+    for (int i = 0; i < repos.size(); ++i) {
+        RepoDatabase database;
+
+        if (!database.read(repoPaths.at(i) + "/" + repos.at(i)->name + dbEnding)) {
+            cerr << "error: " << database.lastError().toUtf8().data() << endl;
+            return 1;
+        }
+
+        databases.append(database);
+    }
+
+    cout << "package databases: " << timer.restart() << " ms, resident memory " << Global::residentMemory() << " kB, interned strings "
+         << StringPool::size() << endl;
+
+    return 0;
+}
+
+
+
+bool dropCaches() {
+    sync();
+
+    QFile file("/proc/sys/vm/drop_caches");
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    const bool success = (file.write("3\n") == 2);
+    file.close();
+
+    return success;
+}
+
+
+
+int benchmarkSnapshot(const QString branchName) {
+    const QString repoDir = Global::getConfig().repoDir;
+    const QString branchPath = repoDir + "/" + branchName;
+    const QString clonePath = repoDir + "/." + branchName + ".boxit_benchmark_clone";
+    const QString copyPath = repoDir + "/." + branchName + ".boxit_benchmark_copy";
+    QStringList linkEndings;
+    linkEndings << BOXIT_DB_ENDING << BOXIT_FILES_DB_ENDING << BOXIT_ZSTD_DB_ENDING << BOXIT_ZSTD_FILES_DB_ENDING;
+
+    if (!QDir(branchPath).exists()) {
+        cerr << "error: branch '" << branchName.toUtf8().data() << "' does not exist!" << endl;
+        return 1;
+    }
+
+    // The page cache is dropped before each run. Without root permissions the
+    // alternating order keeps one method from always reading a warm cache.
+    const bool cloneRuns[] = { false, true, true, false };
+    const int runCount = sizeof(cloneRuns) / sizeof(cloneRuns[0]);
+    qint64 cloneTime = 0, copyTime = 0;
+    bool dropCache = true;
+
+    for (int i = 0; i < runCount; ++i) {
+        const bool clone = cloneRuns[i];
+
+        Global::rmDir(clonePath);
+        Global::rmDir(copyPath);
+
+        if (dropCache && !dropCaches()) {
+            cerr << "warning: failed to drop the page cache, runs are only alternated! Run as root to drop it." << endl;
+            dropCache = false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // Same clone as a branch snapshot or full copy as done before copy-on-write clones
+        const bool success = clone ? Global::cloneDir(branchPath, clonePath, linkEndings) : Global::copyDir(branchPath, copyPath, true);
+        const qint64 time = timer.elapsed();
+
+        if (!success) {
+            cerr << "error: failed to " << (clone ? "clone" : "copy") << " branch '" << branchName.toUtf8().data() << "'!" << endl;
+            Global::rmDir(clonePath);
+            Global::rmDir(copyPath);
+            return 1;
+        }
+
+        cout << "run " << i + 1 << ", " << (clone ? "clone" : "copy") << ": " << time << " ms" << endl;
+
+        if (clone)
+            cloneTime += time;
+        else
+            copyTime += time;
+    }
+
+    Global::rmDir(clonePath);
+    Global::rmDir(copyPath);
+
+    cout << "clone average: " << cloneTime / (runCount / 2) << " ms" << endl;
+    cout << "copy average: " << copyTime / (runCount / 2) << " ms" << endl;
+
+    return 0;
+}
+
+
+
+class LockReaderThread : public QThread
+{
+public:
+    LockReaderThread(volatile bool *stop, const QStringList & branches) :
+        stop(stop), branches(branches)
+    {
+        operations = 0;
+        totalLatency = 0;
+        maxLatency = 0;
+    }
+
+    qint64 operations, totalLatency, maxLatency;
+
+protected:
+    void run() {
+        const QStringList files = QStringList() << "boxit-benchmark-1.0-1-any.pkg.tar.zst";
+        QList<Repo::MetadataPtr> list;
+        QStringList missingFiles;
+        QElapsedTimer timer;
+
+        while (!*stop) {
+            timer.start();
+
+            foreach (const QString branchName, branches) {
+                Database::getRepos(branchName, list, false);
+                Database::isBranchLocked(branchName);
+            }
+
+            Database::checkPoolFilesExists(files, missingFiles);
+
+            const qint64 latency = timer.nsecsElapsed() / 1000;
+            totalLatency += latency;
+            maxLatency = qMax(maxLatency, latency);
+            ++operations;
+        }
+    }
+
+private:
+    volatile bool *stop;
+    const QStringList branches;
+};
+
+
+
+class SnapshotWriterThread : public QThread
+{
+public:
+    SnapshotWriterThread(volatile bool *stop, const QString firstBranch, const QString secondBranch) :
+        stop(stop), firstBranch(firstBranch), secondBranch(secondBranch)
+    {
+        snapshots = 0;
+        refused = 0;
+    }
+
+    qint64 snapshots, refused;
+
+protected:
+    void run() {
+        // The snapshot session reports its end through the status signals
+        QEventLoop loop;
+        QObject::connect(&Status::self, SIGNAL(branchSessionFinished(int)), &loop, SLOT(quit()));
+        QObject::connect(&Status::self, SIGNAL(branchSessionFailed(int)), &loop, SLOT(quit()));
+
+        bool forward = true;
+
+        while (!*stop) {
+            int sessionID;
+
+            if (!Database::snapshotBranch(forward ? firstBranch : secondBranch, forward ? secondBranch : firstBranch, "benchmark", sessionID)) {
+                ++refused;
+                msleep(100);
+                continue;
+            }
+
+            loop.exec();
+
+            ++snapshots;
+            forward = !forward;
+        }
+    }
+
+private:
+    volatile bool *stop;
+    const QString firstBranch, secondBranch;
+};
+
+
+
+void runLockBenchmark(const int threads, const int seconds, const QString firstBranch, const QString secondBranch, const bool snapshots) {
+    volatile bool stop = false;
+    QList<LockReaderThread*> readers;
+    SnapshotWriterThread writer(&stop, firstBranch, secondBranch);
+    const QStringList branches = Database::getBranches();
+
+    for (int i = 0; i < threads; ++i)
+        readers.append(new LockReaderThread(&stop, branches));
+
+    if (snapshots)
+        writer.start();
+
+    foreach (LockReaderThread *reader, readers)
+        reader->start();
+
+    // Snapshots create and delete their repositories on the main thread
+    QEventLoop loop;
+    QTimer::singleShot(seconds * 1000, &loop, SLOT(quit()));
+    loop.exec();
+
+    stop = true;
+
+    while (!writer.wait(10))
+        QCoreApplication::processEvents();
+
+    qint64 operations = 0, totalLatency = 0, maxLatency = 0;
+
+    foreach (LockReaderThread *reader, readers) {
+        reader->wait();
+        operations += reader->operations;
+        totalLatency += reader->totalLatency;
+        maxLatency = qMax(maxLatency, reader->maxLatency);
+        delete reader;
+    }
+
+    cout << threads << " reader thread(s), " << (snapshots ? "snapshots running" : "no snapshot") << ": "
+         << operations / seconds << " reads/s, latency " << (operations > 0 ? totalLatency / operations : 0) << " us average, "
+         << maxLatency << " us max";
+
+    if (snapshots)
+        cout << ", " << writer.snapshots << " snapshots, " << writer.refused << " refused";
+
+    cout << endl;
+}
+
+
+
+int benchmarkLocks(const QString firstBranch, const QString secondBranch, const int threads, const int seconds) {
+    if (threads <= 0 || seconds <= 0 || firstBranch == secondBranch) {
+        printHelp();
+        return 1;
+    }
+
+    // Don't send a memo e-mail for each snapshot
+    Global::Config config = Global::getConfig();
+    config.mailingListEMails.clear();
+    Global::setConfig(config);
+
+    if (!initDatabase())
+        return 1;
+
+    if (!Database::getBranches().contains(firstBranch) || !Database::getBranches().contains(secondBranch)) {
+        cerr << "error: branch '" << firstBranch.toUtf8().data() << "' or '" << secondBranch.toUtf8().data() << "' does not exist!" << endl;
+        return 1;
+    }
+
+    // A read is one getRepos and isBranchLocked per branch and one pool lookup.
+    // The writer snapshots the two branches onto each other, one at a time.
+    runLockBenchmark(threads, seconds, firstBranch, secondBranch, false);
+    runLockBenchmark(threads, seconds, firstBranch, secondBranch, true);
+
+    return 0;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const QString command = args.value(1);
+
+    if (command == "packageset")
+        return benchmarkPackageSet(args.value(2, "30000").toInt());
+
+    // Commands which use the server config and their required argument count
+    QHash<QString, int> commands;
+    commands.insert("database", 2);
+    commands.insert("memory", 0);
+    commands.insert("snapshot", 1);
+    commands.insert("locks", 3);
+
+    if (!commands.contains(command) || args.size() - 2 < commands.value(command)) {
+        printHelp();
+        return 1;
+    }
+
+    // Read config
+    if (!Global::readConfig()) {
+        cerr << "error: failed to read BoxIt config or config is incomplete!" << endl;
+        return 1;
+    }
+
+    if (!QDir(BOXIT_SESSION_TMP).exists() && !QDir().mkpath(BOXIT_SESSION_TMP)) {
+        cerr << "error: failed to create '" << BOXIT_SESSION_TMP << "'!" << endl;
+        return 1;
+    }
+
+    if (command == "database") {
+        return benchmarkDatabase(args.at(2), args.at(3), args.value(4, "0").toInt());
+    }
+    else if (command == "memory") {
+        return benchmarkMemory(args.value(2) != "--no-intern");
+    }
+    else if (command == "snapshot") {
+        return benchmarkSnapshot(args.at(2));
+    }
+    else if (command == "locks") {
+        return benchmarkLocks(args.at(2), args.at(3), args.at(4).toInt(), args.value(5, "10").toInt());
+    }
+
+    printHelp();
+    return 1;
+}
@@ -0,0 +1,70 @@
+#-------------------------------------------------
+#
+# BoxIt server sources without main().
+# Shared by boxit-server.pro and benchmark/benchmark.pro.
+#
+#-------------------------------------------------
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/network/boxitthread.cpp \
+    $$PWD/network/boxitsocket.cpp \
+    $$PWD/network/boxitserver.cpp \
+    $$PWD/boxitinstance.cpp \
+    $$PWD/user/userdbs.cpp \
+    $$PWD/user/user.cpp \
+    $$PWD/global.cpp \
+    $$PWD/sync/sync.cpp \
+    $$PWD/sync/download.cpp \
+    $$PWD/sync/sha256/sha256.c \
+    $$PWD/sync/sha256/cryptsha256.cpp \
+    $$PWD/maintimer.cpp \
+    $$PWD/db/database.cpp \
+    $$PWD/db/branch.cpp \
+    $$PWD/db/repo.cpp \
+    $$PWD/db/status.cpp \
+    $$PWD/db/repodatabase.cpp \
+    $$PWD/db/packageset.cpp \
+    $$PWD/db/commitscheduler.cpp \
+    $$PWD/db/parallelgzip.cpp \
+    $$PWD/db/zstdfile.cpp \
+    $$PWD/db/commitjournal.cpp \
+    $$PWD/db/packagelistfile.cpp \
+    $$PWD/db/repocache.cpp \
+    $$PWD/db/stringpool.cpp \
+    $$PWD/db/poolstore.cpp \
+    $$PWD/db/poolindex.cpp \
+    $$PWD/db/poolreferences.cpp
+
+HEADERS += \
+    $$PWD/network/boxitthread.h \
+    $$PWD/network/boxitsocket.h \
+    $$PWD/network/boxitserver.h \
+    $$PWD/const.h \
+    $$PWD/boxitinstance.h \
+    $$PWD/user/userdbs.h \
+    $$PWD/user/user.h \
+    $$PWD/global.h \
+    $$PWD/sync/sync.h \
+    $$PWD/sync/download.h \
+    $$PWD/sync/sha256/sha256.h \
+    $$PWD/sync/sha256/cryptsha256.h \
+    $$PWD/maintimer.h \
+    $$PWD/db/database.h \
+    $$PWD/db/branch.h \
+    $$PWD/db/repo.h \
+    $$PWD/db/status.h \
+    $$PWD/db/repodatabase.h \
+    $$PWD/db/packageset.h \
+    $$PWD/db/commitscheduler.h \
+    $$PWD/db/compressedfile.h \
+    $$PWD/db/parallelgzip.h \
+    $$PWD/db/zstdfile.h \
+    $$PWD/db/commitjournal.h \
+    $$PWD/db/packagelistfile.h \
+    $$PWD/db/repocache.h \
+    $$PWD/db/stringpool.h \
+    $$PWD/db/poolstore.h \
+    $$PWD/db/poolindex.h \
+    $$PWD/db/poolreferences.h
@@ -28,6 +28,7 @@ BoxitInstance::BoxitInstance(const int sessionID) :
     loginCount = 0;
     listenOnStatus = false;
     syncSessionID = -1;
+    snapSessionID = -1;
 
     // Create tmp dir
     cleanupTmpDir();
@@ -149,15 +150,16 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
     case MSG_GET_REPOS:
     case MSG_GET_REPOS_WITH_PACKAGES:
     {
-        QList<Database::RepoInfo> repos;
+        QList<Repo::MetadataPtr> repos;
 
-        if (!Database::getRepos(QString(data), repos)) {
+        // Package lists are only loaded if requested
+        if (!Database::getRepos(QString(data), repos, msgID == MSG_GET_REPOS_WITH_PACKAGES)) {
             sendData(MSG_ERROR);
             break;
         }
 
         for (int i = 0; i < repos.size(); ++i) {
-            const Database::RepoInfo *repo = &repos.at(i);
+            const Repo::MetadataPtr repo = repos.at(i);
 
             // Send repository informations
             QString str = repo->name;
@@ -200,12 +202,13 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
         break;
     }
     case MSG_MOVE_POOL_FILES: {
-        if (!Database::moveFilesToPool(sessionID, tmpPath, uploadedFiles)) {
+        if (!Database::moveFilesToPool(sessionID, tmpPath, uploadedFiles, uploadedCheckSums)) {
             sendData(MSG_ERROR);
             break;
         }
 
         uploadedFiles.clear();
+        uploadedCheckSums.clear();
 
         sendData(MSG_SUCCESS);
         break;
@@ -213,6 +216,7 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
     case MSG_RELEASE_POOL_LOCK: {
         Database::releasePoolLock(sessionID);
         uploadedFiles.clear();
+        uploadedCheckSums.clear();
 
         sendData(MSG_SUCCESS);
         break;
@@ -224,6 +228,9 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
             break;
         }
 
+        // A new session result is expected
+        pendingSessionResults.clear();
+
         if (!Database::lockRepo(list.at(0), list.at(1), list.at(2), sessionID, user.getUsername())) {
             sendData(MSG_ERROR);
             break;
@@ -268,11 +275,20 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
         listenOnStatus = true;
         sendData(MSG_SUCCESS);
         sendStatus();
+
+        // Deliver session results which arrived before the client started listening
+        QMutexLocker locker(&statusMutex);
+
+        foreach (const quint16 msgID, pendingSessionResults)
+            sendData(msgID);
+
+        pendingSessionResults.clear();
         break;
     }
     case MSG_STOP_LISTEN_ON_STATUS:
     {
         listenOnStatus = false;
+        pendingSessionResults.clear();
 
         // Wait a little...
         sleep(1);
@@ -289,6 +305,9 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
             break;
         }
 
+        // A new session result is expected
+        pendingSessionResults.clear();
+
         if (!Database::synchronizeBranch(branchName, user.getUsername(), syncSessionID)) {
             syncSessionID = -1;
             sendData(MSG_ERROR);
@@ -390,7 +409,12 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
             break;
         }
 
-        if (!Database::snapshotBranch(split.at(0), split.at(1), user.getUsername(), sessionID)) {
+        // A new session result is expected
+        pendingSessionResults.clear();
+
+        // The snapshot runs in the background. Its result is sent to the listening client.
+        if (!Database::snapshotBranch(split.at(0), split.at(1), user.getUsername(), snapSessionID)) {
+            snapSessionID = -1;
             sendData(MSG_ERROR);
             break;
         }
@@ -479,8 +503,10 @@ void BoxitInstance::read_Data(quint16 msgID, QByteArray data) {
             break;
         }
 
-        // Add to list
-        uploadedFiles.append(file.fileName().split("/", QString::SkipEmptyParts).last());
+        // Add to list. The verified checksum is cached by the pool index.
+        const QString fileName = file.fileName().split("/", QString::SkipEmptyParts).last();
+        uploadedFiles.append(fileName);
+        uploadedCheckSums.insert(fileName, fileCheckSum);
 
         fileCheckSum.clear();
         file.setFileName("");
@@ -530,6 +556,23 @@ void BoxitInstance::sendStringList(const quint16 msgID, const QStringList & list
 
 
 
+void BoxitInstance::sendSessionResult(const int sessionID, const quint16 msgID) {
+    QMutexLocker locker(&statusMutex);
+
+    if (this->sessionID != sessionID && this->syncSessionID != sessionID && this->snapSessionID != sessionID)
+        return;
+
+    // Remember the result until the client listens on status
+    if (!listenOnStatus) {
+        pendingSessionResults.append(msgID);
+        return;
+    }
+
+    sendData(msgID);
+}
+
+
+
 void BoxitInstance::sendStatus() {
     QMutexLocker locker(&statusMutex);
 
@@ -575,21 +618,11 @@ void BoxitInstance::sendStatus() {
 
 
 void BoxitInstance::statusBranchSessionFinished(int sessionID) {
-    QMutexLocker locker(&statusMutex);
-
-    if (!listenOnStatus || (this->sessionID != sessionID && this->syncSessionID != sessionID))
-        return;
-
-    sendData(MSG_STATUS_SESSION_FINISHED);
+    sendSessionResult(sessionID, MSG_STATUS_SESSION_FINISHED);
 }
 
 
 
 void BoxitInstance::statusBranchSessionFailed(int sessionID) {
-    QMutexLocker locker(&statusMutex);
-
-    if (!listenOnStatus || (this->sessionID != sessionID && this->syncSessionID != sessionID))
-        return;
-
-    sendData(MSG_STATUS_SESSION_FAILED);
+    sendSessionResult(sessionID, MSG_STATUS_SESSION_FAILED);
 }
@@ -30,6 +30,7 @@
 #include <QCryptographicHash>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QHash>
 #include <unistd.h>
 
 #include "network/boxitsocket.h"
@@ -48,16 +49,19 @@ public:
 
 private:
     const QString tmpPath;
-    int loginCount, syncSessionID;
+    int loginCount, syncSessionID, snapSessionID;
     User user;
     QFile file;
     QByteArray fileCheckSum;
     QStringList uploadedFiles;
+    QHash<QString, QByteArray> uploadedCheckSums;
     bool listenOnStatus;
+    QList<quint16> pendingSessionResults;
     QMutex statusMutex;
 
     void cleanupTmpDir();
     void sendStringList(const quint16 msgID, const QStringList & list);
+    void sendSessionResult(const int sessionID, const quint16 msgID);
 
 private slots:
     void read_Data(quint16 msgID, QByteArray data);
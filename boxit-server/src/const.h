@@ -22,7 +22,7 @@
 #define CONST_H
 
 
-#define BOXIT_VERSION 6
+#define BOXIT_VERSION 7
 #define BOXIT_PORT 59872
 #define BOXIT_SPLIT_CHAR "|"
 #define BOXIT_SOCKET_MAX_SIZE 50000
@@ -31,22 +31,42 @@
 #define BOXIT_TMP "/var/tmp/boxit"
 #define BOXIT_SESSION_TMP "/var/tmp/boxit/sessions"
 #define BOXIT_STATUS_TMP "/var/tmp/boxit/status"
+#define BOXIT_FILES_CACHE_TMP "/var/tmp/boxit/filescache"
 #define BOXIT_DB_CONFIG ".config"
 #define BOXIT_DB_SYNC_EXCLUDE ".sync_exclude"
 #define BOXIT_ARCHITECTURES "x86_64"
 #define BOXIT_OVERLAY_POOL "pool/overlay"
 #define BOXIT_SYNC_POOL "pool/sync"
-#define BOXIT_PACKAGE_FILTERS "*.pkg.tar.xz *.pkg.tar.gz"
+#define BOXIT_POOL_OBJECTS_ENDING ".objects"
+#define BOXIT_POOL_INDEX_ENDING ".index"
+#define BOXIT_POOL_INDEX_VERSION 2
+#define BOXIT_POOL_SHARD_LENGTH 2
+#define BOXIT_PACKAGE_FILTERS "*.pkg.tar.zst *.pkg.tar.xz *.pkg.tar.gz"
 #define BOXIT_SIGNATURE_ENDING ".sig"
 #define BOXIT_DB_ENDING ".db.tar.gz"
 #define BOXIT_DB_LINK_ENDING ".db"
+#define BOXIT_ZSTD_DB_ENDING ".db.tar.zst"
 #define BOXIT_DB_DESC_FILE "desc"
 #define BOXIT_FILES_DB_ENDING ".files.tar.gz"
 #define BOXIT_FILES_DB_LINK_ENDING ".files"
+#define BOXIT_ZSTD_FILES_DB_ENDING ".files.tar.zst"
 #define BOXIT_REMOVE_ORPHANS_AFTER_DAYS 3
 #define BOXIT_STATE_FILE "state"
+#define BOXIT_JOURNAL_FILE ".journal"
+#define BOXIT_JOURNAL_CHECKPOINT_INTERVAL 32
+#define BOXIT_PACKAGE_LIST_SIDECAR_ENDING ".bin"
+#define BOXIT_PACKAGE_LIST_MAGIC "BXPL"
+#define BOXIT_PACKAGE_LIST_VERSION 1
+#define BOXIT_STRING_POOL_LOOKUP_SIZE 256
 #define BOXIT_SYSTEM_USERNAME "system"
 #define BOXIT_SYSTEM_SESSION_ID 1
+#define BOXIT_DEFAULT_COMMIT_WORKERS 2
+#define BOXIT_DEFAULT_PREPARE_JOBS_PER_DEVICE 1
+#define BOXIT_DEFAULT_DB_COMPRESSION_LEVEL 6
+#define BOXIT_DEFAULT_REPO_CACHE_SIZE 256
+#define BOXIT_GZIP_BLOCK_SIZE 131072
+#define BOXIT_GZIP_DICTIONARY_SIZE 32768
+#define BOXIT_TAR_END_SIZE 1024
 
 
 // Socket IDs
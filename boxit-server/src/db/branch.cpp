@@ -31,13 +31,40 @@ Branch::Branch(const QString name, const QString path) :
 
 
 Branch::~Branch() {
-    qDeleteAll(repos);
-    repos.clear();
+    removeRepos();
 }
 
 
 
 bool Branch::init() {
+    if (!initConfig())
+        return false;
+
+    QMetaObject::invokeMethod(this, "createRepos", mainThreadConnection());
+
+    // Initialize all repositories one after another
+    QList<bool> results;
+
+    foreach (Repo *repo, repos)
+        results.append(repo->init());
+
+    qRegisterMetaType< QList<bool> >("QList<bool>");
+    QMetaObject::invokeMethod(this, "removeFailedRepos", mainThreadConnection(), Q_ARG(QList<bool>, results));
+
+    return true;
+}
+
+
+
+void Branch::release() {
+    // The repositories are gone on return. Their directories might be reused right away.
+    QMetaObject::invokeMethod(this, "removeRepos", mainThreadConnection());
+    deleteLater();
+}
+
+
+
+bool Branch::initConfig() {
     // Read config
     if (!readConfig())
         return false;
@@ -48,39 +75,60 @@ bool Branch::init() {
         return false;
 
 
-    // Get branch repos
-    qDeleteAll(repos);
-    repos.clear();
+    // Find branch repos
+    repoLocations.clear();
 
     QStringList repoList = QDir(path).entryList(QDir::AllDirs | QDir::NoDotAndDotDot, QDir::Name);
     QStringList architectures = QString(BOXIT_ARCHITECTURES).split(" ", QString::SkipEmptyParts);
 
     foreach (QString repoName, repoList) {
         foreach (QString architecture, architectures) {
-            QString repoPath = path + "/" + repoName + "/" + architecture;
+            RepoLocation location;
+            location.name = repoName;
+            location.architecture = architecture;
+            location.path = path + "/" + repoName + "/" + architecture;
 
-            if (!QDir(repoPath).exists())
+            if (!QDir(location.path).exists())
                 continue;
 
-            Repo *repo = new Repo(name, repoName, architecture, repoPath);
+            repoLocations.append(location);
+        }
+    }
 
-            if (!repo->init()) {
-                cerr << "warning: failed to init repo '" << repoPath.toUtf8().data() << "'!" << endl;
-                delete (repo);
-                continue;
-            }
+    return true;
+}
 
-            connect(repo, SIGNAL(requestNewBranchState())   ,   this, SLOT(setNewBranchState()));
-            connect(repo, SIGNAL(threadFailed(Repo*,int))   ,   this, SLOT(repoThreadFailed(Repo*,int)));
-            connect(repo, SIGNAL(threadWaiting(Repo*,int))  ,   this, SLOT(repoThreadWaiting(Repo*,int)));
-            connect(repo, SIGNAL(threadFinished(Repo*,int))  ,   this, SLOT(repoThreadFinished(Repo*,int)));
 
-            repos.append(repo);
-        }
+
+void Branch::createRepos() {
+    qDeleteAll(repos);
+    repos.clear();
+
+    foreach (const RepoLocation location, repoLocations) {
+        Repo *repo = new Repo(name, location.name, location.architecture, location.path);
+
+        connect(repo, SIGNAL(requestNewBranchState())   ,   this, SLOT(setNewBranchState()));
+        connect(repo, SIGNAL(threadStarted(Repo*,int))  ,   this, SLOT(repoThreadStarted(Repo*,int)), Qt::DirectConnection);
+        connect(repo, SIGNAL(threadFailed(Repo*,int))   ,   this, SLOT(repoThreadFailed(Repo*,int)));
+        connect(repo, SIGNAL(threadWaiting(Repo*,int))  ,   this, SLOT(repoThreadWaiting(Repo*,int)));
+        connect(repo, SIGNAL(threadFinished(Repo*,int))  ,   this, SLOT(repoThreadFinished(Repo*,int)));
+
+        repos.append(repo);
     }
 
+    repoLocations.clear();
+}
 
-    return true;
+
+
+void Branch::removeFailedRepos(const QList<bool> & results) {
+    for (int i = repos.size() - 1; i >= 0; --i) {
+        if (i < results.size() && results.at(i))
+            continue;
+
+        cerr << "warning: failed to init repo '" << repos.at(i)->getPath().toUtf8().data() << "'!" << endl;
+        delete (repos.takeAt(i));
+    }
 }
 
 
@@ -108,11 +156,45 @@ bool Branch::setUrl(const QString url) {
 
 
 
+void Branch::sealCommitSession(const int sessionID) {
+    QMutexLocker locker(&repoThreadMutex);
+
+    if (!commitBarriers.contains(sessionID))
+        return;
+
+    CommitBarrier *barrier = &commitBarriers[sessionID];
+    barrier->sealed = true;
+
+    // No further repositories join a failed session
+    if (barrier->failed) {
+        commitBarriers.remove(sessionID);
+        return;
+    }
+
+    commitSessionIfReady(sessionID);
+}
+
+
+
 //###
 //### Private
 //###
 
 
+void Branch::removeRepos() {
+    qDeleteAll(repos);
+    repos.clear();
+}
+
+
+
+Qt::ConnectionType Branch::mainThreadConnection() {
+    // Block the calling worker thread until the main thread executed the call
+    return (QThread::currentThread() == qApp->thread()) ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+}
+
+
+
 bool Branch::readExcludeContentConfig() {
     // Clean up first
     excludeFiles.clear();
@@ -213,61 +295,76 @@ void Branch::setNewBranchState() {
 
 
 
-void Branch::repoThreadFailed(Repo*, int threadSessionID) {
-    QMutexLocker locker(&repoThreadMutex);
+void Branch::commitSessionIfReady(const int sessionID) {
+    // Requires a locked repoThreadMutex
+    CommitBarrier *barrier = &commitBarriers[sessionID];
 
-    // Abort all other threads with the same session ID
-    for (int i = 0; i < repos.size(); ++i) {
-        Repo *r = repos[i];
+    if (!barrier->sealed || barrier->failed || barrier->prepared.size() < barrier->participants.size())
+        return;
 
-        if (r->getThreadSessionID() == threadSessionID && r->isRunning())
-            r->abort();
+    // All repositories of this session are prepared. Queue their commit jobs.
+    foreach (Repo *r, barrier->prepared) {
+        if (!barrier->finished.contains(r))
+            r->commit();
     }
+}
 
-    // Inform the socket with the same session ID
-    Status::branchSessionChanged(threadSessionID, false);
+
+
+void Branch::repoThreadStarted(Repo *repo, int threadSessionID) {
+    QMutexLocker locker(&repoThreadMutex);
+
+    CommitBarrier *barrier = &commitBarriers[threadSessionID];
+
+    // Join the barrier. A sealed session is reopened until it releases its locks again.
+    barrier->participants.insert(repo);
+    barrier->prepared.remove(repo);
+    barrier->finished.remove(repo);
+    barrier->sealed = false;
 }
 
 
 
-void Branch::repoThreadWaiting(Repo *repo, int threadSessionID) {
+void Branch::repoThreadFailed(Repo*, int threadSessionID) {
     QMutexLocker locker(&repoThreadMutex);
 
-    // Check if another repo thread with the same session ID is running
-    bool found = false;
+    if (!commitBarriers.contains(threadSessionID))
+        return;
+
+    CommitBarrier *barrier = &commitBarriers[threadSessionID];
+    if (barrier->failed)
+        return;
 
-    for (int i = 0; i < repos.size(); ++i) {
-        Repo *r = repos[i];
+    barrier->failed = true;
 
-        if (r != repo
-                && r->isRunning()
-                && !r->waitingForCommit()
-                && r->getThreadSessionID() == threadSessionID) {
-            found = true;
-            break;
-        }
+    // Abort all other repository processes of this session
+    foreach (Repo *r, barrier->participants) {
+        if (r->getThreadSessionID() == threadSessionID && r->isRunning())
+            r->abort();
     }
 
-    // Next Thread will trigger the commit
-    if (found)
-        return;
+    // Keep a failed barrier until the session is sealed to abort late participants
+    if (barrier->sealed)
+        commitBarriers.remove(threadSessionID);
+
+    // Inform the socket with the same session ID
+    Status::branchSessionChanged(threadSessionID, false);
+}
 
 
-    // Commit all changes
-    for (int i = 0; i < repos.size(); ++i) {
-        Repo *r = repos[i];
 
-        if (r->getThreadSessionID() == threadSessionID && r->waitingForCommit()) {
-            // Wait for a short time if this is the calling repository process.
-            // The wait condition might not sleep. We have to be sure it is already waiting...
-            // Otherwise this would cause a deadlock!
-            if (r == repo)
-                usleep(650000);
+void Branch::repoThreadWaiting(Repo *repo, int threadSessionID) {
+    QMutexLocker locker(&repoThreadMutex);
 
-            // Commit changes to repository
-            r->commit();
-        }
+    // The session failed or is gone. Never commit these changes.
+    if (!commitBarriers.contains(threadSessionID) || commitBarriers[threadSessionID].failed) {
+        repo->abort();
+        return;
     }
+
+    // Arrive at the barrier
+    commitBarriers[threadSessionID].prepared.insert(repo);
+    commitSessionIfReady(threadSessionID);
 }
 
 
@@ -275,24 +372,17 @@ void Branch::repoThreadWaiting(Repo *repo, int threadSessionID) {
 void Branch::repoThreadFinished(Repo *repo, int threadSessionID) {
     QMutexLocker locker(&repoThreadMutex);
 
-    // Check if another repo thread with the same session ID is running
-    bool found = false;
-
-    for (int i = 0; i < repos.size(); ++i) {
-        Repo *r = repos[i];
+    if (!commitBarriers.contains(threadSessionID))
+        return;
 
-        if (r != repo
-                && r->isRunning()
-                && r->getThreadSessionID() == threadSessionID) {
-            found = true;
-            break;
-        }
-    }
+    CommitBarrier *barrier = &commitBarriers[threadSessionID];
+    barrier->finished.insert(repo);
 
-    // Next Thread will trigger the signal
-    if (found)
+    if (barrier->failed || !barrier->sealed || barrier->finished.size() < barrier->participants.size())
         return;
 
+    commitBarriers.remove(threadSessionID);
+
     // Inform the socket with the same session ID
     Status::branchSessionChanged(threadSessionID, true);
 }
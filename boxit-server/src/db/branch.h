@@ -27,7 +27,12 @@
 #include <QStringList>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QHash>
+#include <QSet>
 #include <QCoreApplication>
+#include <QThread>
+#include <QMetaType>
 #include <unistd.h>
 
 #include "global.h"
@@ -45,10 +50,24 @@ public:
     const QString name, path;
     QList<Repo*> repos;
 
+    // Guards the lock states of the repositories and the branch config.
+    // Read locked to look at them, write locked to change them.
+    QReadWriteLock rwLock;
+
     Branch(const QString name, const QString path);
     ~Branch();
 
+    // init() and release() may run on worker threads. They create and delete
+    // the repositories on the main thread, which has to run its event loop.
     bool init();
+    void release();
+
+    // Split initialization. initConfig() and the Repo::init() calls may run on
+    // worker threads. createRepos() and removeFailedRepos() create and delete
+    // QObjects and have to run on the main thread.
+    bool initConfig();
+    Q_INVOKABLE void createRepos();
+    Q_INVOKABLE void removeFailedRepos(const QList<bool> & results);
     bool setExcludeFilesContent(const QString content);
     bool setUrl(const QString url);
 
@@ -56,17 +75,45 @@ public:
     QStringList getExcludeFiles() { return excludeFiles; }
     QString getExcludeFilesContent() { return excludeFilesContent; }
 
+    void sealCommitSession(const int sessionID);
+
 private:
+    struct RepoLocation {
+        QString name, architecture, path;
+    };
+
+    QList<RepoLocation> repoLocations;
+
+    // Two-phase commit barrier of a session.
+    // Repositories join as soon as their commit process is started. The
+    // session is sealed as soon as it releases its repository locks. Commit
+    // jobs are queued once the barrier is sealed and every joined repository
+    // has prepared its changes.
+    struct CommitBarrier {
+        QSet<Repo*> participants, prepared, finished;
+        bool sealed, failed;
+
+        CommitBarrier() {
+            sealed = false;
+            failed = false;
+        }
+    };
+
+    QHash<int, CommitBarrier> commitBarriers;
     QMutex repoThreadMutex, setBranchStateMutex;
     QString url, excludeFilesContent;
     QStringList excludeFiles;
 
+    Q_INVOKABLE void removeRepos();
+    Qt::ConnectionType mainThreadConnection();
     bool readExcludeContentConfig();
     bool readConfig();
     bool updateConfig();
+    void commitSessionIfReady(const int sessionID);
 
 private slots:
     void setNewBranchState();
+    void repoThreadStarted(Repo *repo, int threadSessionID);
     void repoThreadFailed(Repo *repo, int threadSessionID);
     void repoThreadWaiting(Repo *repo, int threadSessionID);
     void repoThreadFinished(Repo *repo, int threadSessionID);
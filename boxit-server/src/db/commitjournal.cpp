@@ -0,0 +1,192 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "commitjournal.h"
+
+
+
+CommitJournal::CommitJournal(const QString path) :
+    path(path)
+{
+    pendingTransactions = 0;
+}
+
+
+
+bool CommitJournal::append(const Transaction & transaction) {
+    QByteArray data;
+
+    data.append("BEGIN " + transaction.id.toUtf8() + "\n");
+    data.append("STATE " + transaction.state.toUtf8() + "\n");
+    data.append("DATABASE " + transaction.databaseStamp.toUtf8() + "\n");
+    data.append("FILES " + transaction.filesStamp.toUtf8() + "\n");
+
+    foreach (const QString package, transaction.removeOverlayPackages)
+        data.append("REMOVE_OVERLAY " + package.toUtf8() + "\n");
+
+    foreach (const QString package, transaction.addOverlayPackages)
+        data.append("ADD_OVERLAY " + package.toUtf8() + "\n");
+
+    foreach (const QString package, transaction.removeSyncPackages)
+        data.append("REMOVE_SYNC " + package.toUtf8() + "\n");
+
+    foreach (const QString package, transaction.addSyncPackages)
+        data.append("ADD_SYNC " + package.toUtf8() + "\n");
+
+    data.append("COMMIT " + transaction.id.toUtf8() + "\n");
+
+    if (!appendData(data))
+        return false;
+
+    ++pendingTransactions;
+
+    return true;
+}
+
+
+
+bool CommitJournal::abort(const QString id) {
+    return appendData("ABORT " + id.toUtf8() + "\n");
+}
+
+
+
+bool CommitJournal::checkpoint() {
+    int fd = open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        errorString = "failed to truncate journal '" + path + "'";
+        return false;
+    }
+
+    bool success = (fsync(fd) == 0);
+    close(fd);
+
+    if (!success) {
+        errorString = "failed to flush journal '" + path + "'";
+        return false;
+    }
+
+    pendingTransactions = 0;
+
+    return true;
+}
+
+
+
+bool CommitJournal::read(QList<Transaction> & transactions) {
+    transactions.clear();
+    pendingTransactions = 0;
+
+    QFile file(path);
+    if (!file.exists())
+        return true;
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        errorString = "failed to read journal '" + path + "'";
+        return false;
+    }
+
+    Transaction transaction;
+    bool inTransaction = false;
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        const QString type = line.section(" ", 0, 0);
+        const QString value = line.section(" ", 1);
+
+        if (type == "BEGIN") {
+            transaction = Transaction();
+            transaction.id = value;
+            inTransaction = true;
+        }
+        else if (type == "ABORT") {
+            for (int i = 0; i < transactions.size(); ++i) {
+                if (transactions.at(i).id == value)
+                    transactions.removeAt(i--);
+            }
+        }
+        else if (!inTransaction) {
+            continue;
+        }
+        else if (type == "STATE") {
+            transaction.state = value;
+        }
+        else if (type == "DATABASE") {
+            transaction.databaseStamp = value;
+        }
+        else if (type == "FILES") {
+            transaction.filesStamp = value;
+        }
+        else if (type == "REMOVE_OVERLAY") {
+            transaction.removeOverlayPackages.append(value);
+        }
+        else if (type == "ADD_OVERLAY") {
+            transaction.addOverlayPackages.append(value);
+        }
+        else if (type == "REMOVE_SYNC") {
+            transaction.removeSyncPackages.append(value);
+        }
+        else if (type == "ADD_SYNC") {
+            transaction.addSyncPackages.append(value);
+        }
+        else if (type == "COMMIT") {
+            // Transactions without commit record were torn by a crash and are ignored
+            if (value == transaction.id)
+                transactions.append(transaction);
+
+            inTransaction = false;
+        }
+    }
+
+    file.close();
+
+    pendingTransactions = transactions.size();
+
+    return true;
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+bool CommitJournal::appendData(const QByteArray & data) {
+    int fd = open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        errorString = "failed to open journal '" + path + "'";
+        return false;
+    }
+
+    // Every record is flushed on its own. A commit publishes its databases right after
+    // its record is appended, so the record has to be durable at that point.
+    bool success = (write(fd, data.constData(), data.size()) == data.size() && fdatasync(fd) == 0);
+    close(fd);
+
+    if (!success)
+        errorString = "failed to write journal '" + path + "'";
+
+    return success;
+}
@@ -0,0 +1,72 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMITJOURNAL_H
+#define COMMITJOURNAL_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QFile>
+#include <QTextStream>
+#include <QByteArray>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "const.h"
+
+
+// Append-only write-ahead journal of repository commits.
+// A transaction records the new repository state and the package list
+// changes as diffs. Applying a diff twice has no further effect, so all
+// transactions since the last checkpoint can be replayed in order on top of
+// whatever state files were written before a crash.
+// Each transaction is written with a single write and fsync. The state files
+// are only flushed and the journal truncated on checkpoints.
+// The stamps identify the unpublished database and database files of the
+// commit. Each file is checked on its own, because a crash might happen
+// between publishing the two files.
+class CommitJournal
+{
+public:
+    struct Transaction {
+        QString id, state, databaseStamp, filesStamp;
+        QStringList addOverlayPackages, removeOverlayPackages, addSyncPackages, removeSyncPackages;
+    };
+
+    CommitJournal(const QString path);
+
+    bool append(const Transaction & transaction);
+    bool abort(const QString id);
+    bool checkpoint();
+    bool read(QList<Transaction> & transactions);
+
+    int getPendingTransactions()    { return pendingTransactions; }
+    QString lastError()             { return errorString; }
+
+private:
+    const QString path;
+    QString errorString;
+    int pendingTransactions;
+
+    bool appendData(const QByteArray & data);
+};
+
+#endif // COMMITJOURNAL_H
@@ -0,0 +1,98 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "commitscheduler.h"
+#include "repo.h"
+
+
+
+QThreadPool CommitScheduler::pool;
+QMutex CommitScheduler::mutex;
+QHash<quint64, int> CommitScheduler::runningPrepareJobs;
+QHash<quint64, QList<Repo*> > CommitScheduler::waitingPrepareJobs;
+
+
+
+void CommitScheduler::init() {
+    pool.setMaxThreadCount(qMax(1, Global::getConfig().commitWorkers));
+}
+
+
+
+void CommitScheduler::submit(Repo *repo, const CommitScheduler::JOB job) {
+    // Higher priorities are dequeued first
+    if (job == JOB_COMMIT) {
+        pool.start(new Job(repo, job, 0), 1);
+        return;
+    }
+
+    const quint64 device = getDevice(repo);
+    const int maxJobs = Global::getConfig().prepareJobsPerDevice;
+
+    QMutexLocker locker(&mutex);
+
+    // Wait until a prepare job of the same device is done
+    if (maxJobs > 0 && runningPrepareJobs.value(device, 0) >= maxJobs) {
+        waitingPrepareJobs[device].append(repo);
+        return;
+    }
+
+    ++runningPrepareJobs[device];
+    pool.start(new Job(repo, job, device), 0);
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+void CommitScheduler::runJob(Repo *repo, const CommitScheduler::JOB job, const quint64 device) {
+    if (job == JOB_COMMIT) {
+        repo->commitChanges();
+        return;
+    }
+
+    repo->prepare();
+
+    QMutexLocker locker(&mutex);
+
+    // Start the next waiting prepare job of this device
+    if (!waitingPrepareJobs.value(device).isEmpty()) {
+        pool.start(new Job(waitingPrepareJobs[device].takeFirst(), JOB_PREPARE, device), 0);
+        return;
+    }
+
+    if (--runningPrepareJobs[device] <= 0)
+        runningPrepareJobs.remove(device);
+}
+
+
+
+quint64 CommitScheduler::getDevice(Repo *repo) {
+    struct stat info;
+
+    if (stat(QFile::encodeName(repo->getPath()).constData(), &info) != 0)
+        return 0;
+
+    return info.st_dev;
+}
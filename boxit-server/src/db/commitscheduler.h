@@ -0,0 +1,78 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMITSCHEDULER_H
+#define COMMITSCHEDULER_H
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QList>
+#include <sys/stat.h>
+
+#include "global.h"
+#include "const.h"
+
+class Repo;
+
+
+// Runs the prepare and commit jobs of all repositories on a bounded pool of
+// worker threads. The pool size is set with the commitWorkers config key.
+// Commit jobs are queued before prepare jobs: they only rename and link files
+// and finish a session, while a prepare job reads all added packages.
+// Prepare jobs are I/O heavy. Only prepareJobsPerDevice of them run at the
+// same time on the repositories of one device. Further ones wait in a queue
+// of the device without blocking a worker thread.
+class CommitScheduler
+{
+public:
+    enum JOB {
+        JOB_PREPARE,
+        JOB_COMMIT
+    };
+
+    static void init();
+    static void submit(Repo *repo, const CommitScheduler::JOB job);
+
+private:
+    class Job : public QRunnable
+    {
+    public:
+        Job(Repo *repo, const CommitScheduler::JOB job, const quint64 device) : repo(repo), job(job), device(device) {}
+        void run() { CommitScheduler::runJob(repo, job, device); }
+
+    private:
+        Repo *repo;
+        const CommitScheduler::JOB job;
+        const quint64 device;
+    };
+
+    static QThreadPool pool;
+    static QMutex mutex;
+    static QHash<quint64, int> runningPrepareJobs;
+    static QHash<quint64, QList<Repo*> > waitingPrepareJobs;
+
+    static void runJob(Repo *repo, const CommitScheduler::JOB job, const quint64 device);
+    static quint64 getDevice(Repo *repo);
+};
+
+#endif // COMMITSCHEDULER_H
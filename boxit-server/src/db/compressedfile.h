@@ -0,0 +1,43 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+#include <QString>
+
+
+// Interface of the compressed file writers used for repository databases.
+class CompressedFile
+{
+public:
+    virtual ~CompressedFile() {}
+
+    virtual bool open(const QString path) = 0;
+    virtual bool write(const char *data, const qint64 size) = 0;
+    virtual bool close() = 0;
+
+    QString lastError() { return errorString; }
+
+protected:
+    QString errorString;
+};
+
+#endif // COMPRESSEDFILE_H
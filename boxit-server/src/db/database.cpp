@@ -20,16 +20,20 @@
 
 #include "database.h"
 
-QMutex Database::mutex;
+QMutex Database::syncMutex;
+QReadWriteLock Database::branchesLock;
+QReadWriteLock Database::poolLock;
 Sync Database::sync;
 QList<Branch*> Database::branches;
 QMap<int, Database::PoolLock> Database::lockedPoolFiles;
-QStringList Database::poolFiles;
+PoolIndex *Database::overlayPool = NULL;
+PoolIndex *Database::syncPool = NULL;
+QThreadPool Database::snapshotPool;
 
 
 
-void Database::init() {
-    QMutexLocker locker(&mutex);
+bool Database::init() {
+    QWriteLocker locker(&branchesLock);
 
     // Create pool directories if they don't exist
     if (!QDir(Global::getConfig().overlayPoolDir).exists() && !QDir().mkpath(Global::getConfig().overlayPoolDir))
@@ -41,34 +45,122 @@ void Database::init() {
 
     qDeleteAll(branches);
     branches.clear();
+    PoolReferences::clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Load the pool indexes. The pools are only scanned if the saved indexes are outdated.
+    {
+        QWriteLocker poolLocker(&poolLock);
+
+        delete overlayPool;
+        delete syncPool;
+        overlayPool = new PoolIndex(Global::getConfig().overlayPoolDir);
+        syncPool = new PoolIndex(Global::getConfig().syncPoolDir);
+
+        if (!overlayPool->load())
+            cerr << "warning: failed to read overlay pool directory!" << endl;
+
+        if (!syncPool->load())
+            cerr << "warning: failed to read sync pool directory!" << endl;
+
+        // Misplaced files aren't indexed. Repositories would miss their packages and the files would never be cleaned up.
+        if (overlayPool->getMisplacedEntries() > 0 || syncPool->getMisplacedEntries() > 0) {
+            cerr << "error: the pool doesn't match the configured layout (shardedPool)! Stop the server and run boxit-server --migrate-pool" << endl;
+            return false;
+        }
+
+        cout << "loaded pool indexes with " << overlayPool->size() << " overlay and " << syncPool->size() << " sync files in " << timer.restart() << " ms" << endl;
+    }
 
     QString dbDir = Global::getConfig().repoDir;
     QStringList branchList = QDir(dbDir).entryList(QDir::AllDirs | QDir::NoDotAndDotDot, QDir::Name);
+    QList<Branch*> initBranches;
 
     foreach (QString branchName, branchList) {
         if (!QFile::exists(dbDir + "/" + branchName + "/" + BOXIT_DB_CONFIG))
             continue; // Seams to be no branch folder...
 
-        Branch *branch = new Branch(branchName, dbDir + "/" + branchName);
+        initBranches.append(new Branch(branchName, dbDir + "/" + branchName));
+    }
+
+    // Branches and repositories are initialized concurrently. Objects are created on this thread.
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+
+    // Read all branch configs
+    QVector<InitResult> branchResults(initBranches.size());
+
+    for (int i = 0; i < initBranches.size(); ++i)
+        pool.start(new InitJob(initBranches[i], NULL, branchResults.data() + i));
+
+    pool.waitForDone();
+
+    // Initialize all repositories of all branches
+    QList<Repo*> initRepos;
+
+    for (int i = 0; i < initBranches.size(); ++i) {
+        if (!branchResults.at(i).success)
+            continue;
+
+        initBranches[i]->createRepos();
+        initRepos.append(initBranches[i]->repos);
+    }
 
-        if (!branch->init()) {
-            cerr << "warning: failed to init branch '" << branchName.toUtf8().data() << "'!" << endl;
+    QVector<InitResult> repoResults(initRepos.size());
+
+    for (int i = 0; i < initRepos.size(); ++i)
+        pool.start(new InitJob(NULL, initRepos[i], repoResults.data() + i));
+
+    pool.waitForDone();
+
+    // Merge the results in directory order
+    int repoIndex = 0;
+
+    for (int i = 0; i < initBranches.size(); ++i) {
+        Branch *branch = initBranches[i];
+
+        if (!branchResults.at(i).success) {
+            cerr << "warning: failed to init branch '" << branch->name.toUtf8().data() << "'!" << endl;
             delete (branch);
             continue;
         }
 
+        QList<bool> results;
+        qint64 totalTime = 0, maxTime = 0;
+
+        for (int x = 0; x < branch->repos.size(); ++x, ++repoIndex) {
+            const InitResult & result = repoResults.at(repoIndex);
+
+            results.append(result.success);
+            totalTime += result.elapsed;
+            maxTime = qMax(maxTime, result.elapsed);
+        }
+
+        branch->removeFailedRepos(results);
         branches.append(branch);
+
+        cout << "branch '" << branch->name.toUtf8().data() << "': config " << branchResults.at(i).elapsed << " ms, "
+             << results.size() << " repositories in " << totalTime << " ms (slowest " << maxTime << " ms)" << endl;
     }
 
+    cout << "initialized " << branches.size() << " branches in " << timer.elapsed() << " ms" << endl;
 
-    // Get all pool files
-    poolFiles = QDir(Global::getConfig().overlayPoolDir).entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+
+    QWriteLocker poolLocker(&poolLock);
+
+    // Save rebuilt indexes right away
+    if ((overlayPool->isModified() && !overlayPool->save()) || (syncPool->isModified() && !syncPool->save()))
+        cerr << "warning: failed to save pool index!" << endl;
+
+    return true;
 }
 
 
 
 QStringList Database::getBranches() {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     QStringList list;
 
@@ -84,13 +176,15 @@ QStringList Database::getBranches() {
 
 
 bool Database::getBranchUrl(const QString branchName, QString & url) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
         return false;
 
+    QReadLocker branchLocker(&branch->rwLock);
+
     url = branch->getUrl();
 
     return true;
@@ -99,26 +193,30 @@ bool Database::getBranchUrl(const QString branchName, QString & url) {
 
 
 bool Database::setBranchUrl(const QString branchName, const QString url) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
         return false;
 
+    QWriteLocker branchLocker(&branch->rwLock);
+
     return branch->setUrl(url);
 }
 
 
 
 bool Database::getBranchSyncExcludeFiles(const QString branchName, QString & excludeFilesContent) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
         return false;
 
+    QReadLocker branchLocker(&branch->rwLock);
+
     excludeFilesContent = branch->getExcludeFilesContent();
 
     return true;
@@ -127,26 +225,30 @@ bool Database::getBranchSyncExcludeFiles(const QString branchName, QString & exc
 
 
 bool Database::setBranchSyncExcludeFiles(const QString branchName, const QString excludeFilesContent) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
         return false;
 
+    QWriteLocker branchLocker(&branch->rwLock);
+
     return branch->setExcludeFilesContent(excludeFilesContent);
 }
 
 
 
 bool Database::isBranchLocked(const QString branchName) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
         return false;
 
+    QReadLocker branchLocker(&branch->rwLock);
+
     for (int i = 0; i < branch->repos.size(); ++i) {
         if (branch->repos[i]->isLocked())
             return true;
@@ -157,8 +259,8 @@ bool Database::isBranchLocked(const QString branchName) {
 
 
 
-bool Database::getRepos(const QString branchName, QList<Database::RepoInfo> & list) {
-    QMutexLocker locker(&mutex);
+bool Database::getRepos(const QString branchName, QList<Repo::MetadataPtr> & list, const bool withPackages) {
+    QReadLocker locker(&branchesLock);
 
     list.clear();
 
@@ -167,20 +269,9 @@ bool Database::getRepos(const QString branchName, QList<Database::RepoInfo> & li
     if (branch == NULL)
         return false;
 
-    // Add repos to list
-    for (int i = 0; i < branch->repos.size(); ++i) {
-        Repo *repo = branch->repos[i];
-
-        Database::RepoInfo info;
-        info.name = repo->getName();
-        info.architecture = repo->getArchitecture();
-        info.state = repo->getState();
-        info.isSyncRepo = repo->isSyncable();
-        info.overlayPackages = repo->getOverlayPackages();
-        info.syncPackages = repo->getSyncPackages();
-
-        list.append(info);
-    }
+    // Add the published metadata snapshots to the list. They are never changed.
+    for (int i = 0; i < branch->repos.size(); ++i)
+        list.append(branch->repos[i]->getMetadata(withPackages));
 
     return true;
 }
@@ -188,32 +279,45 @@ bool Database::getRepos(const QString branchName, QList<Database::RepoInfo> & li
 
 
 bool Database::lockRepo(const QString branchName, const QString repoName, const QString repoArchitecture, const int sessionID, const QString username) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
+    Branch *branch = _getBranch(branchName);
     Repo *repo = _getRepo(branchName, repoName, repoArchitecture);
-    if (repo == NULL)
+    if (branch == NULL || repo == NULL)
         return false;
 
+    QWriteLocker branchLocker(&branch->rwLock);
+
     return repo->lock(sessionID, username);
 }
 
 
 
 bool Database::adjustRepoFiles(const QString branchName, const QString repoName, const QString repoArchitecture, const int sessionID, const QStringList & addPackages, const QStringList & removePackages) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
+    Branch *branch = _getBranch(branchName);
     Repo *repo = _getRepo(branchName, repoName, repoArchitecture);
-    if (repo == NULL)
+    if (branch == NULL || repo == NULL)
         return false;
 
+    QReadLocker branchLocker(&branch->rwLock);
+
     // Check if repo is locked by session ID
     if (repo->getLockedSessionID() != sessionID)
         return false;
 
     // Check if the new packages exist in the overlay pool
-    foreach (QString package, addPackages) {
-        if (!poolFiles.contains(package))
-            return false;
+    {
+        QReadLocker poolLocker(&poolLock);
+
+        foreach (QString package, addPackages) {
+            if (!overlayPool->contains(package))
+                return false;
+
+            // Protect it from the orphan sweep until it is committed
+            PoolReferences::touch(package, false);
+        }
     }
 
     return repo->adjustPackages(addPackages, removePackages);
@@ -222,7 +326,7 @@ bool Database::adjustRepoFiles(const QString branchName, const QString repoName,
 
 
 void Database::releaseRepoLock(const int sessionID) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&branchesLock);
 
     // Release all locked repos
     _releaseRepoLock(sessionID);
@@ -231,7 +335,7 @@ void Database::releaseRepoLock(const int sessionID) {
 
 
 bool Database::lockPoolFiles(const int sessionID, const QString username, const QStringList & files) {
-    QMutexLocker locker(&mutex);
+    QWriteLocker locker(&poolLock);
 
     // Check if files are already locked
     QMap<int, PoolLock>::const_iterator i = lockedPoolFiles.constBegin();
@@ -257,14 +361,14 @@ bool Database::lockPoolFiles(const int sessionID, const QString username, const
 
 
 bool Database::checkPoolFilesExists(const QStringList & files, QStringList & missingFiles) {
-    QMutexLocker locker(&mutex);
+    QReadLocker locker(&poolLock);
 
     bool success = true;
     missingFiles.clear();
 
     // Check if files exists...
     foreach (QString file, files) {
-        if (!poolFiles.contains(file)) {
+        if (!overlayPool->contains(file)) {
             missingFiles.append(file);
             success = false;
         }
@@ -278,20 +382,39 @@ bool Database::checkPoolFilesExists(const QStringList & files, QStringList & mis
 
 
 bool Database::getPoolFileCheckSum(const QString file, QByteArray & checkSum) {
-    QMutexLocker locker(&mutex);
+    {
+        QReadLocker locker(&poolLock);
+
+        if (!overlayPool->contains(file))
+            return false;
 
-    if (!poolFiles.contains(file))
+        // Use the cached checksum if the file didn't change
+        if (overlayPool->getCheckSum(file, checkSum))
+            return true;
+    }
+
+    // Hash the file without blocking the pool and cache the checksum.
+    // It is only cached if the file didn't change while hashing it.
+    const QString filePath = Global::poolFilePath(Global::getConfig().overlayPoolDir, file);
+    PoolIndex::Entry before, after;
+
+    if (!PoolIndex::statFile(filePath, before))
         return false;
 
-    checkSum = Global::sha1CheckSum(Global::getConfig().overlayPoolDir + "/" + file);
+    checkSum = Global::sha1CheckSum(filePath);
+
+    if (!checkSum.isEmpty() && PoolIndex::statFile(filePath, after) && PoolIndex::sameFile(before, after)) {
+        QWriteLocker locker(&poolLock);
+        overlayPool->setCheckSum(file, after, checkSum);
+    }
 
     return true;
 }
 
 
 
-bool Database::moveFilesToPool(const int sessionID, const QString path, QStringList files) {
-    QMutexLocker locker(&mutex);
+bool Database::moveFilesToPool(const int sessionID, const QString path, QStringList files, const QHash<QString, QByteArray> & checkSums) {
+    QWriteLocker locker(&poolLock);
 
     files.removeDuplicates();
 
@@ -300,8 +423,8 @@ bool Database::moveFilesToPool(const int sessionID, const QString path, QStringL
         return false;
 
     // Check if files already exists in the pool directory
-    foreach (QString file, poolFiles) {
-        if (files.contains(file))
+    foreach (QString file, files) {
+        if (overlayPool->contains(file))
             return false;
     }
 
@@ -315,15 +438,23 @@ bool Database::moveFilesToPool(const int sessionID, const QString path, QStringL
 
     // Move files to pool directory
     const QString poolDir = Global::getConfig().overlayPoolDir;
+    QStringList movedFiles;
     QDir dir;
     bool success = true;
 
     foreach (QString file, files) {
-        if (dir.rename(path + "/" + file, poolDir + "/" + file)) {
-            poolFiles.append(file);
+        const QString poolFile = Global::poolFilePath(poolDir, file);
+
+        if (dir.mkpath(Global::poolFileDir(poolDir, file)) && dir.rename(path + "/" + file, poolFile)) {
+            movedFiles.append(file);
 
             // Fix file permission
-            Global::fixFilePermission(poolDir + "/" + file);
+            Global::fixFilePermission(poolFile);
+            overlayPool->update(file, checkSums.value(file));
+
+            // Orphan until a commit references it
+            PoolReferences::touch(file, false);
+            PoolReferences::addCandidate(file, false, QDateTime::currentDateTime().toTime_t());
         }
         else {
             qDebug(file.toUtf8());
@@ -331,13 +462,29 @@ bool Database::moveFilesToPool(const int sessionID, const QString path, QStringL
         }
     }
 
+    // Hash and store the new files without blocking other sessions.
+    // Error isn't critical. The orphan cleanup stores them later.
+    locker.unlock();
+
+    if (!PoolStore::isEnabled())
+        return success;
+
+    foreach (const QString file, movedFiles)
+        PoolStore::add(Global::poolFilePath(poolDir, file));
+
+    // Stored files are replaced by links to their objects
+    locker.relock();
+
+    foreach (const QString file, movedFiles)
+        overlayPool->update(file, checkSums.value(file));
+
     return success;
 }
 
 
 
 void Database::releasePoolLock(const int sessionID) {
-    QMutexLocker locker(&mutex);
+    QWriteLocker locker(&poolLock);
 
     // Release locked pool session
     _releasePoolLock(sessionID);
@@ -345,12 +492,58 @@ void Database::releasePoolLock(const int sessionID) {
 
 
 
+bool Database::syncPoolFileExists(const QString file) {
+    QReadLocker locker(&poolLock);
+
+    if (!syncPool->contains(file))
+        return false;
+
+    // The synchronization references it later
+    PoolReferences::touch(file, true);
+
+    return true;
+}
+
+
+
+void Database::updateSyncPoolFiles(const QStringList & files) {
+    QWriteLocker locker(&poolLock);
+
+    // Files which don't exist anymore are removed from the index.
+    // New files are orphans until a commit references them.
+    foreach (const QString file, files) {
+        if (!syncPool->update(file))
+            continue;
+
+        PoolReferences::touch(file, true);
+
+        if (!PoolReferences::isReferenced(file, true))
+            PoolReferences::addCandidate(file, true, QDateTime::currentDateTime().toTime_t());
+    }
+}
+
+
+
+void Database::savePoolIndexes() {
+    QWriteLocker locker(&poolLock);
+
+    if (overlayPool->isModified() && !overlayPool->save())
+        cerr << "error: failed to save overlay pool index!" << endl;
+
+    if (syncPool->isModified() && !syncPool->save())
+        cerr << "error: failed to save sync pool index!" << endl;
+}
+
+
+
 bool Database::synchronizeBranch(const QString branchName, const QString username, int & syncSessionID) {
-    QMutexLocker locker(&mutex);
+    QMutexLocker syncLocker(&syncMutex);
 
     if (sync.isRunning())
         return false;
 
+    QReadLocker locker(&branchesLock);
+
     // Get branch
     Branch *branch = _getBranch(branchName);
     if (branch == NULL)
@@ -363,11 +556,8 @@ bool Database::synchronizeBranch(const QString branchName, const QString usernam
 
 
 
-bool Database::snapshotBranch(const QString sourceBranchName, const QString destBranchName, const QString username, const int sessionID) {
-    QMutexLocker locker(&mutex);
-
-    bool returnCode = false;
-    QList<Global::RepoChanges> repoChangesList;
+bool Database::snapshotBranch(const QString sourceBranchName, const QString destBranchName, const QString username, int & snapSessionID) {
+    QReadLocker locker(&branchesLock);
 
     if (sourceBranchName == destBranchName)
         return false;
@@ -378,357 +568,535 @@ bool Database::snapshotBranch(const QString sourceBranchName, const QString dest
     if (sourceBranch == NULL || destBranch == NULL)
         return false;
 
+    // Lock both branches in the order of the branch list
+    Branch *firstBranch = sourceBranch, *secondBranch = destBranch;
+    if (branches.indexOf(destBranch) < branches.indexOf(sourceBranch))
+        qSwap(firstBranch, secondBranch);
+
+    firstBranch->rwLock.lockForWrite();
+    secondBranch->rwLock.lockForWrite();
+
+    bool success = true;
 
     // Check if any repository of source or destination branch is locked
-    for (int i = 0; i < sourceBranch->repos.size(); ++i) {
+    for (int i = 0; i < sourceBranch->repos.size() && success; ++i) {
         if (sourceBranch->repos[i]->isLocked())
-            return false;
+            success = false;
     }
 
-    for (int i = 0; i < destBranch->repos.size(); ++i) {
+    for (int i = 0; i < destBranch->repos.size() && success; ++i) {
         if (destBranch->repos[i]->isLocked())
-            return false;
+            success = false;
     }
 
 
+    // The snapshot has its own session. It keeps running if the client disconnects.
+    snapSessionID = Global::getNewUniqueSessionID();
+
     // Try to lock branches
-    for (int i = 0; i < sourceBranch->repos.size(); ++i) {
-        if (!sourceBranch->repos[i]->lock(sessionID, username))
-            goto unlockRepos;
+    for (int i = 0; i < sourceBranch->repos.size() && success; ++i) {
+        if (!sourceBranch->repos[i]->lock(snapSessionID, username))
+            success = false;
     }
 
-    for (int i = 0; i < destBranch->repos.size(); ++i) {
-        if (!destBranch->repos[i]->lock(sessionID, username))
-            goto unlockRepos;
+    for (int i = 0; i < destBranch->repos.size() && success; ++i) {
+        if (!destBranch->repos[i]->lock(snapSessionID, username))
+            success = false;
     }
 
+    secondBranch->rwLock.unlock();
+    firstBranch->rwLock.unlock();
 
+    if (!success) {
+        _releaseRepoLock(snapSessionID);
+        return false;
+    }
 
-    // Get all changes for the status e-mail
-    {
-        // First get all added repos
-        for (int i = 0; i < sourceBranch->repos.size(); ++i) {
-            Repo *srcRepo = sourceBranch->repos[i];
-            bool found = false;
+    // Status update
+    Status::setBranchStateChanged(destBranchName, "waiting for snapshot", "", Status::STATE_WAITING);
 
-            for (int i = 0; i < destBranch->repos.size(); ++i) {
-                Repo *destRepo = destBranch->repos[i];
+    // Run the snapshot in the background. The locked repositories of both branches protect it.
+    snapshotPool.start(new SnapshotJob(sourceBranch, destBranch, username, snapSessionID));
 
-                if (srcRepo->getName() == destRepo->getName() && srcRepo->getArchitecture() == destRepo->getArchitecture()) {
-                    found = true;
-                    break;
-                }
-            }
+    return true;
+}
 
-            if (found)
-                continue;
 
-            Global::RepoChanges repoChanges;
-            repoChanges.branchName = destBranch->name;
-            repoChanges.repoName = srcRepo->getName();
-            repoChanges.repoArchitecture = srcRepo->getArchitecture();
-            repoChanges.addedPackages = srcRepo->getSyncPackages();
-            repoChanges.addedPackages.append(srcRepo->getOverlayPackages());
 
-            if (repoChanges.addedPackages.isEmpty())
-                continue;
+void Database::releaseSession(const int sessionID) {
+    QReadLocker locker(&branchesLock);
 
-            repoChangesList.append(repoChanges);
-        }
+    // Release all locked repos
+    _releaseRepoLock(sessionID);
 
-        // Get all removed repos
-        for (int i = 0; i < destBranch->repos.size(); ++i) {
-            Repo *destRepo = destBranch->repos[i];
-            bool found = false;
+    // Release locked pool session
+    QWriteLocker poolLocker(&poolLock);
+    _releasePoolLock(sessionID);
+}
 
-            for (int i = 0; i < sourceBranch->repos.size(); ++i) {
-                Repo *srcRepo = sourceBranch->repos[i];
 
-                if (srcRepo->getName() == destRepo->getName() && srcRepo->getArchitecture() == destRepo->getArchitecture()) {
-                    found = true;
-                    break;
-                }
-            }
 
-            if (found)
-                continue;
+void Database::removeOrphanPoolFiles() {
+    // No repository is locked. Sessions and synchronizations keep running.
+    // The pool files in use are protected by their references and generations.
+    const quint64 protectedGeneration = PoolReferences::beginSweep();
 
-            Global::RepoChanges repoChanges;
-            repoChanges.branchName = destBranch->name;
-            repoChanges.repoName = destRepo->getName();
-            repoChanges.repoArchitecture = destRepo->getArchitecture();
-            repoChanges.removedPackages = destRepo->getSyncPackages();
-            repoChanges.removedPackages.append(destRepo->getOverlayPackages());
+    // Count the references of all repositories which aren't counted yet.
+    // Files are only removed with complete counts.
+    if (!_countPoolReferences())
+        return;
 
-            if (repoChanges.removedPackages.isEmpty())
-                continue;
+    // Remove all orphan candidates which are unreferenced long enough
+    const qint64 maxTime = QDateTime::currentDateTime().toTime_t() - qint64(BOXIT_REMOVE_ORPHANS_AFTER_DAYS) * 86400;
+    QList<PoolReferences::Candidate> candidates;
+    int removed = 0;
 
-            repoChangesList.append(repoChanges);
+    PoolReferences::takeExpiredCandidates(maxTime, candidates);
+
+    foreach (const PoolReferences::Candidate candidate, candidates) {
+        if (_removeOrphanFile(candidate.syncPool ? syncPool : overlayPool, candidate, maxTime, protectedGeneration))
+            ++removed;
+    }
+
+    if (removed > 0)
+        cout << "removed " << removed << " orphan pool file(s)" << endl;
+
+    // Remove stored objects of removed files and store files which aren't stored yet.
+    // Only indexed files are stored. They are complete.
+    if (PoolStore::isEnabled()) {
+        PoolStore::removeUnusedObjects();
+        _importPool(overlayPool);
+        _importPool(syncPool);
+    }
+
+    savePoolIndexes();
+}
+
+
+
+
+bool Database::migratePools() {
+    // Move all pool files to the configured layout. The server isn't running.
+    if (!_migratePool(Global::getConfig().overlayPoolDir) || !_migratePool(Global::getConfig().syncPoolDir))
+        return false;
+
+    // Load all branches. The pool indexes are rebuilt.
+    if (!init())
+        return false;
+
+    // Retarget the package symlinks of all repositories
+    QReadLocker locker(&branchesLock);
+    bool success = true;
+
+    for (int i = 0; i < branches.size(); ++i) {
+        Branch *branch = branches[i];
+
+        for (int x = 0; x < branch->repos.size(); ++x) {
+            if (!branch->repos[x]->relinkPackages())
+                success = false;
         }
+    }
 
-        // Get all package changes
-        for (int i = 0; i < sourceBranch->repos.size(); ++i) {
-            Repo *srcRepo = sourceBranch->repos[i];
+    return success;
+}
 
-            for (int i = 0; i < destBranch->repos.size(); ++i) {
-                Repo *destRepo = destBranch->repos[i];
 
-                if (srcRepo->getName() != destRepo->getName() || srcRepo->getArchitecture() != destRepo->getArchitecture())
-                    continue;
 
-                Global::RepoChanges repoChanges;
-                repoChanges.branchName = destBranch->name;
-                repoChanges.repoName = srcRepo->getName();
-                repoChanges.repoArchitecture = srcRepo->getArchitecture();
 
-                QStringList oldPackages = destRepo->getSyncPackages();
-                oldPackages.append(destRepo->getOverlayPackages());
+//###
+//### Private
+//###
 
-                QStringList newPackages = srcRepo->getSyncPackages();
-                newPackages.append(srcRepo->getOverlayPackages());
 
-                // Added packages
-                foreach (const QString package, newPackages) {
-                    if (!oldPackages.contains(package))
-                        repoChanges.addedPackages.append(package);
-                }
+void Database::InitJob::run() {
+    QElapsedTimer timer;
+    timer.start();
 
-                // Removed packages
-                foreach (const QString package, oldPackages) {
-                    if (!newPackages.contains(package))
-                        repoChanges.removedPackages.append(package);
-                }
+    if (repo)
+        result->success = repo->init();
+    else
+        result->success = branch->initConfig();
 
-                repoChanges.addedPackages.removeDuplicates();
-                repoChanges.removedPackages.removeDuplicates();
-                repoChanges.addedPackages.sort();
-                repoChanges.removedPackages.sort();
+    result->elapsed = timer.elapsed();
+}
 
-                if (repoChanges.addedPackages.isEmpty() && repoChanges.removedPackages.isEmpty())
-                    continue;
 
-                repoChangesList.append(repoChanges);
 
+void Database::runSnapshot(Branch *sourceBranch, Branch *destBranch, const QString username, const int sessionID) {
+    const QString sourceBranchName = sourceBranch->name;
+    const QString destBranchName = destBranch->name;
+    QList<Global::RepoChanges> repoChangesList;
+    bool success = false;
+
+    // Status update
+    Status::setBranchStateChanged(destBranchName, "collecting snapshot changes", "", Status::STATE_RUNNING);
+
+    // Get all changes for the status e-mail. This loads the package lists of the
+    // replaced repositories, which release their pool references on deletion.
+    getSnapshotChanges(sourceBranch, destBranch, repoChangesList);
+
+    // Status update
+    Status::setBranchStateChanged(destBranchName, "cloning branch '" + sourceBranchName + "'", "", Status::STATE_RUNNING);
+
+    const bool cloned = cloneBranch(sourceBranch, destBranch);
+
+
+    if (cloned) {
+        // Status update
+        Status::setBranchStateChanged(destBranchName, "initializing branch", "", Status::STATE_RUNNING);
+
+        // Initialize the new branch before it replaces the old one.
+        // Its repositories are created on the main thread.
+        Branch *newBranch = new Branch(destBranchName, Global::getConfig().repoDir + "/" + destBranchName);
+        const bool initialized = newBranch->init();
+        Branch *oldBranch = NULL;
+
+        if (!initialized) {
+            cerr << "error: failed to init branch '" << destBranchName.toUtf8().data() << "'!" << endl;
+            newBranch->release();
+        }
+
+        {
+            QWriteLocker locker(&branchesLock);
+
+            // Remove old branch from list
+            for (int i = 0; i < branches.size(); ++i) {
+                if (branches[i]->name != destBranchName)
+                    continue;
+
+                oldBranch = branches.takeAt(i);
                 break;
             }
+
+            // Add the new branch to the list
+            if (initialized) {
+                branches.append(newBranch);
+                success = true;
+            }
         }
+
+        // Delete the old branch on the main thread. Not while holding the branches lock:
+        // the main thread might wait for it.
+        if (oldBranch)
+            oldBranch->release();
     }
 
+    // Unlock repos again
+    {
+        QReadLocker locker(&branchesLock);
+        _releaseRepoLock(sessionID);
+    }
 
-    // Remove destination branch
-    if (!Global::rmDir(destBranch->path))
-        goto unlockRepos;
 
-    // Copy branch
-    if (!Global::copyDir(sourceBranch->path, destBranch->path, true))
-        goto unlockRepos;
+    if (success) {
+        // Send e-mail
+        Global::sendMemoEMail(QString("### BoxIt memo ###\n\nUser %1 created a snapshot of branch '%2' to '%3'.\n\n").arg(username, sourceBranchName, destBranchName), repoChangesList);
 
-    // Remove old branch from list
-    for (int i = 0; i < branches.size(); ++i) {
-        Branch *branch = branches[i];
+        Status::setBranchStateChanged(destBranchName, "finished snapshot", "", Status::STATE_SUCCESS);
+    }
+    else {
+        Status::setBranchStateChanged(destBranchName, "snapshot failed", "failed to create a snapshot of branch '" + sourceBranchName + "'", Status::STATE_FAILED);
+    }
+
+    Status::branchSessionChanged(sessionID, success);
+}
 
-        if (branch->name != destBranch->name)
+
+
+void Database::getSnapshotChanges(Branch *sourceBranch, Branch *destBranch, QList<Global::RepoChanges> & repoChangesList) {
+    // First get all added repos
+    for (int i = 0; i < sourceBranch->repos.size(); ++i) {
+        Repo *srcRepo = sourceBranch->repos[i];
+        bool found = false;
+
+        for (int i = 0; i < destBranch->repos.size(); ++i) {
+            Repo *destRepo = destBranch->repos[i];
+
+            if (srcRepo->getName() == destRepo->getName() && srcRepo->getArchitecture() == destRepo->getArchitecture()) {
+                found = true;
+                break;
+            }
+        }
+
+        if (found)
             continue;
 
-        branches.removeAt(i);
-        delete branch;
-        break;
-    }
+        Global::RepoChanges repoChanges;
+        repoChanges.branchName = destBranch->name;
+        repoChanges.repoName = srcRepo->getName();
+        repoChanges.repoArchitecture = srcRepo->getArchitecture();
+        repoChanges.addedPackages = srcRepo->getSyncPackages();
+        repoChanges.addedPackages.append(srcRepo->getOverlayPackages());
 
-    // Create new branch and add it to the list
-    destBranch = new Branch(destBranchName, Global::getConfig().repoDir + "/" + destBranchName);
+        if (repoChanges.addedPackages.isEmpty())
+            continue;
 
-    if (!destBranch->init()) {
-        cerr << "error: failed to init branch '" << destBranchName.toUtf8().data() << "'!" << endl;
-        delete (destBranch);
-        goto unlockSourceRepos;
+        repoChangesList.append(repoChanges);
     }
 
-    branches.append(destBranch);
+    // Get all removed repos
+    for (int i = 0; i < destBranch->repos.size(); ++i) {
+        Repo *destRepo = destBranch->repos[i];
+        bool found = false;
 
-    // Send e-mail
-    Global::sendMemoEMail(QString("### BoxIt memo ###\n\nUser %1 created a snapshot of branch '%2' to '%3'.\n\n").arg(username, sourceBranchName, destBranchName), repoChangesList);
+        for (int i = 0; i < sourceBranch->repos.size(); ++i) {
+            Repo *srcRepo = sourceBranch->repos[i];
 
+            if (srcRepo->getName() == destRepo->getName() && srcRepo->getArchitecture() == destRepo->getArchitecture()) {
+                found = true;
+                break;
+            }
+        }
 
-    returnCode = true;
+        if (found)
+            continue;
 
-unlockRepos:
+        Global::RepoChanges repoChanges;
+        repoChanges.branchName = destBranch->name;
+        repoChanges.repoName = destRepo->getName();
+        repoChanges.repoArchitecture = destRepo->getArchitecture();
+        repoChanges.removedPackages = destRepo->getSyncPackages();
+        repoChanges.removedPackages.append(destRepo->getOverlayPackages());
 
-    // Unlock repos again
-    for (int i = 0; i < destBranch->repos.size(); ++i) {
-        Repo *repo = destBranch->repos[i];
+        if (repoChanges.removedPackages.isEmpty())
+            continue;
 
-        if (repo->getLockedSessionID() == sessionID)
-            repo->unlock();
+        repoChangesList.append(repoChanges);
     }
 
-unlockSourceRepos:
+    // Get all package changes
     for (int i = 0; i < sourceBranch->repos.size(); ++i) {
-        Repo *repo = sourceBranch->repos[i];
+        Repo *srcRepo = sourceBranch->repos[i];
 
-        if (repo->getLockedSessionID() == sessionID)
-            repo->unlock();
-    }
+        for (int i = 0; i < destBranch->repos.size(); ++i) {
+            Repo *destRepo = destBranch->repos[i];
 
-    return returnCode;
-}
+            if (srcRepo->getName() != destRepo->getName() || srcRepo->getArchitecture() != destRepo->getArchitecture())
+                continue;
 
+            Global::RepoChanges repoChanges;
+            repoChanges.branchName = destBranch->name;
+            repoChanges.repoName = srcRepo->getName();
+            repoChanges.repoArchitecture = srcRepo->getArchitecture();
 
+            QStringList oldPackages = destRepo->getSyncPackages();
+            oldPackages.append(destRepo->getOverlayPackages());
 
-void Database::releaseSession(const int sessionID) {
-    QMutexLocker locker(&mutex);
+            QStringList newPackages = srcRepo->getSyncPackages();
+            newPackages.append(srcRepo->getOverlayPackages());
 
-    // Release locked pool session
-    _releasePoolLock(sessionID);
+            // Added and removed packages
+            repoChanges.addedPackages = PackageSet::difference(newPackages, oldPackages);
+            repoChanges.removedPackages = PackageSet::difference(oldPackages, newPackages);
 
-    // Release all locked repos
-    _releaseRepoLock(sessionID);
+            repoChanges.addedPackages.removeDuplicates();
+            repoChanges.removedPackages.removeDuplicates();
+            repoChanges.addedPackages.sort();
+            repoChanges.removedPackages.sort();
+
+            if (repoChanges.addedPackages.isEmpty() && repoChanges.removedPackages.isEmpty())
+                continue;
+
+            repoChangesList.append(repoChanges);
+
+            break;
+        }
+    }
 }
 
 
 
-void Database::removeOrphanPoolFiles() {
-    // Lock mutex
-    mutex.lock();
+bool Database::cloneBranch(Branch *sourceBranch, Branch *destBranch) {
+    // Clone the source branch next to the destination branch. The copy-on-write
+    // clone shares the data of all files and databases with the source branch.
+    QElapsedTimer timer;
+    timer.start();
 
-    // Check if sync is running
-    if (sync.isRunning()) {
-        mutex.unlock();
-        return;
+    const QString repoDir = Global::getConfig().repoDir;
+    const QString clonePath = repoDir + "/." + destBranch->name + ".boxit_snapshot";
+    const QString oldPath = repoDir + "/." + destBranch->name + ".boxit_old";
+    QStringList linkEndings;
+    linkEndings << BOXIT_DB_ENDING << BOXIT_FILES_DB_ENDING << BOXIT_ZSTD_DB_ENDING << BOXIT_ZSTD_FILES_DB_ENDING;
+
+    if (!Global::cloneDir(sourceBranch->path, clonePath, linkEndings)) {
+        Global::rmDir(clonePath);
+        return false;
     }
 
-    // Check if any repository is locked
-    for (int i = 0; i < branches.size(); ++i) {
-        Branch *branch = branches[i];
+    // Swap the branches and remove the old destination branch
+    Global::rmDir(oldPath);
 
-        for (int i = 0; i < branch->repos.size(); ++i) {
-            if (branch->repos[i]->isLocked()) {
-                mutex.unlock();
-                return;
-            }
-        }
+    if (!QDir().rename(destBranch->path, oldPath))
+        return false;
+
+    if (!QDir().rename(clonePath, destBranch->path)) {
+        QDir().rename(oldPath, destBranch->path);
+        return false;
     }
 
-    // Try to lock every repository
-    for (int i = 0; i < branches.size(); ++i) {
-        Branch *branch = branches[i];
+    if (!Global::rmDir(oldPath))
+        cerr << "warning: failed to remove '" << oldPath.toUtf8().data() << "'!" << endl;
 
-        for (int i = 0; i < branch->repos.size(); ++i) {
-            if (!branch->repos[i]->lock(BOXIT_SYSTEM_SESSION_ID, BOXIT_SYSTEM_USERNAME)) {
-                // Remove all locks
-                for (int i = 0; i < branches.size(); ++i) {
-                    Branch *branch = branches[i];
+    cout << "snapshot of branch '" << sourceBranch->name.toUtf8().data() << "' to '" << destBranch->name.toUtf8().data() << "' cloned in " << timer.elapsed() << " ms" << endl;
 
-                    for (int i = 0; i < branch->repos.size(); ++i) {
-                        Repo *repo = branch->repos[i];
+    return true;
+}
 
-                        if (repo->getLockedSessionID() == BOXIT_SYSTEM_SESSION_ID)
-                            repo->unlock();
-                    }
-                }
 
-                mutex.unlock();
-                return;
+
+bool Database::_countPoolReferences() {
+    const quint64 countEpoch = PoolReferences::beginCount();
+    bool success = true;
+
+    {
+        QReadLocker locker(&branchesLock);
+
+        for (int i = 0; i < branches.size(); ++i) {
+            Branch *branch = branches[i];
+
+            for (int x = 0; x < branch->repos.size(); ++x) {
+                if (!branch->repos[x]->addPoolReferences(countEpoch)) {
+                    cerr << "warning: failed to count pool references of '" << branch->repos[x]->getPath().toUtf8().data() << "'!" << endl;
+                    success = false;
+                }
             }
         }
     }
 
-    // Get all pool files
-    const QString overlayPoolPath = Global::getConfig().overlayPoolDir;
-    const QString syncPoolPath = Global::getConfig().syncPoolDir;
-    QStringList syncPoolFiles = QDir(syncPoolPath).entryList(QDir::Files | QDir::NoDotAndDotDot);
-    QStringList overlayPoolFiles = QDir(overlayPoolPath).entryList(QDir::Files | QDir::NoDotAndDotDot);
+    bool queueCandidates;
 
-    // Unlock mutex
-    mutex.unlock();
+    if (!success || !PoolReferences::finishCount(countEpoch, queueCandidates))
+        return false;
 
+    if (!queueCandidates)
+        return true;
 
+    // All repositories are counted. Unreferenced files are orphans since their last modification.
+    QWriteLocker locker(&poolLock);
 
-    // Get all packages
-    QStringList allOverlayPackages, allSyncPackages;
+    PoolReferences::clearCandidates();
+    _addOrphanCandidates(overlayPool, false);
+    _addOrphanCandidates(syncPool, true);
 
-    for (int i = 0; i < branches.size(); ++i) {
-        Branch *branch = branches[i];
+    cout << PoolReferences::candidateCount() << " orphan candidates in the pools" << endl;
 
-        for (int i = 0; i < branch->repos.size(); ++i) {
-            Repo *repo = branch->repos[i];
+    return true;
+}
 
-            allOverlayPackages.append(repo->getOverlayPackages());
-            allSyncPackages.append(repo->getSyncPackages());
-        }
+
+
+void Database::_addOrphanCandidates(PoolIndex *pool, const bool syncPool) {
+    // Requires a locked poolLock
+    PoolIndex::Entry entry;
+
+    foreach (const QString file, pool->files()) {
+        if (!PoolReferences::isReferenced(file, syncPool) && pool->get(file, entry))
+            PoolReferences::addCandidate(file, syncPool, entry.mtime);
     }
+}
+
+
+
+bool Database::_removeOrphanFile(PoolIndex *pool, const PoolReferences::Candidate & candidate, const qint64 maxTime, const quint64 protectedGeneration) {
+    // Files are only validated and added while holding the pool lock.
+    // Keep it until the file is removed from the disk and the index.
+    QWriteLocker locker(&poolLock);
+    PoolIndex::Entry entry;
 
-    // Get all orphan files
-    _keepOrphanFiles(overlayPoolFiles, allOverlayPackages);
-    _keepOrphanFiles(syncPoolFiles, allSyncPackages);
+    // Already removed
+    if (!pool->get(candidate.file, entry))
+        return false;
 
-    QDateTime currentDateTime = QDateTime::currentDateTime();
+    // Referenced again
+    if (PoolReferences::isReferenced(candidate.file, candidate.syncPool))
+        return false;
 
-    // Remove all old overlay files
-    foreach (const QString file, overlayPoolFiles) {
-        // Check when it was last modified
-        QString filePath = overlayPoolPath + "/" + file;
-        QFileInfo info(filePath);
+    // The file was replaced or is used by a busy repository. Check it again later.
+    if (entry.mtime > maxTime) {
+        PoolReferences::addCandidate(candidate.file, candidate.syncPool, entry.mtime);
+        return false;
+    }
 
-        if (info.lastModified().daysTo(currentDateTime) >= BOXIT_REMOVE_ORPHANS_AFTER_DAYS)
-            if (!QFile::remove(filePath))
-                cerr << "error: failed to remove '" << filePath.toUtf8().data() << "'!" << endl;
+    if (!PoolReferences::isRemovable(candidate.file, candidate.syncPool, protectedGeneration)) {
+        PoolReferences::addCandidate(candidate.file, candidate.syncPool, QDateTime::currentDateTime().toTime_t());
+        return false;
     }
 
-    // Remove all old sync files
-    foreach (const QString file, syncPoolFiles) {
-        // Check when it was last modified
-        QString filePath = syncPoolPath + "/" + file;
-        QFileInfo info(filePath);
+    const QString filePath = Global::poolFilePath(pool->getPoolPath(), candidate.file);
 
-        if (info.lastModified().daysTo(currentDateTime) >= BOXIT_REMOVE_ORPHANS_AFTER_DAYS)
-            if (!QFile::remove(filePath))
-                cerr << "error: failed to remove '" << filePath.toUtf8().data() << "'!" << endl;
+    if (!QFile::remove(filePath)) {
+        cerr << "error: failed to remove '" << filePath.toUtf8().data() << "'!" << endl;
+        return false;
     }
 
+    pool->remove(candidate.file);
 
-    QMutexLocker locker(&mutex);
+    return true;
+}
 
-    // Remove all locks
-    for (int i = 0; i < branches.size(); ++i) {
-        Branch *branch = branches[i];
 
-        for (int i = 0; i < branch->repos.size(); ++i) {
-            Repo *repo = branch->repos[i];
 
-            if (repo->getLockedSessionID() == BOXIT_SYSTEM_SESSION_ID)
-                repo->unlock();
+bool Database::_migratePool(const QString poolPath) {
+    QDir dir(poolPath);
+    int moved = 0;
+    bool success = true;
+
+    if (Global::getConfig().shardedPool) {
+        // Move each file into its shard directory
+        foreach (const QString file, dir.entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+            if (!dir.mkpath(Global::poolFileDir(poolPath, file)) || !dir.rename(poolPath + "/" + file, Global::poolFilePath(poolPath, file))) {
+                cerr << "error: failed to move '" << file.toUtf8().data() << "' to its pool shard!" << endl;
+                success = false;
+                continue;
+            }
+
+            ++moved;
         }
     }
-}
+    else {
+        // Move the files of all shard directories back to the pool directory
+        foreach (const QString shard, dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (shard.length() != BOXIT_POOL_SHARD_LENGTH)
+                continue;
 
+            QDir shardDir(poolPath + "/" + shard);
 
+            foreach (const QString file, shardDir.entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+                if (!dir.rename(shardDir.path() + "/" + file, poolPath + "/" + file)) {
+                    cerr << "error: failed to move '" << file.toUtf8().data() << "' out of its pool shard!" << endl;
+                    success = false;
+                    continue;
+                }
 
+                ++moved;
+            }
 
-//###
-//### Private
-//###
+            dir.rmdir(shard); // Fails if not empty. Error is not important.
+        }
+    }
+
+    cout << "moved " << moved << " file(s) of '" << poolPath.toUtf8().data() << "'" << endl;
 
+    return success;
+}
 
-void Database::_keepOrphanFiles(QStringList & files, const QStringList & checkPackages) {
-    const int sigLength = QString(BOXIT_SIGNATURE_ENDING).length();
-    QString checkFileName;
 
-    QStringList::iterator it = files.begin();
 
-    while (it != files.end()) {
-        checkFileName = *it;
-        if (checkFileName.endsWith(BOXIT_SIGNATURE_ENDING))
-            checkFileName.chop(sigLength);
+void Database::_importPool(PoolIndex *pool) {
+    QStringList files, importedFiles;
 
-        // Remove from list if it exists in list
-        if (checkPackages.contains(checkFileName))
-            it = files.erase(it);
-        else
-            ++it;
+    {
+        QReadLocker locker(&poolLock);
+        files = pool->files();
     }
 
-    files.removeDuplicates();
+    PoolStore::importPool(pool->getPoolPath(), files, importedFiles);
+
+    // Stored files are replaced by links to their objects
+    QWriteLocker locker(&poolLock);
+
+    foreach (const QString file, importedFiles)
+        pool->update(file);
 }
 
 
@@ -771,6 +1139,7 @@ Repo* Database::_getRepo(const QString branchName, const QString repoName, const
 
 
 void Database::_releasePoolLock(const int sessionID) {
+    // Requires a write locked poolLock
     // Release locked pool session
     lockedPoolFiles.remove(sessionID);
 }
@@ -781,6 +1150,7 @@ void Database::_releaseRepoLock(const int sessionID) {
     // Release all locked repos
     for (int i = 0; i < branches.size(); ++i) {
         Branch *branch = branches[i];
+        QWriteLocker branchLocker(&branch->rwLock);
 
         for (int i = 0; i < branch->repos.size(); ++i) {
             Repo *repo = branch->repos[i];
@@ -790,5 +1160,8 @@ void Database::_releaseRepoLock(const int sessionID) {
 
             repo->unlock();
         }
+
+        // Seal the commit barrier of this session
+        branch->sealCommitSession(sessionID);
     }
 }
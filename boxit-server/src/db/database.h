@@ -26,28 +26,40 @@
 #include <QStringList>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
 #include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
 #include <iostream>
 
 #include "global.h"
 #include "const.h"
 #include "branch.h"
+#include "packageset.h"
+#include "poolstore.h"
+#include "poolindex.h"
+#include "poolreferences.h"
 #include "sync/sync.h"
 
 
 using namespace std;
 
 
+// Lock order. Locks are always acquired top down:
+//   1. syncMutex       starting a synchronization
+//   2. branchesLock    the branch list. Write locked only to add or replace branches.
+//   3. Branch::rwLock  repository lock states and config of one branch.
+//                      Several branches are locked in the order of the branch list.
+//   4. poolLock        the pool indexes and the pool file locks
+// The repository and branch internal mutexes and the pool reference counts are below all of them.
 class Database
 {
 public:
-    struct RepoInfo {
-        QString name, architecture, state;
-        bool isSyncRepo;
-        QStringList overlayPackages, syncPackages;
-    };
-
-    static void init();
+    static bool init();
 
     static QStringList getBranches();
     static bool getBranchUrl(const QString branchName, QString & url);
@@ -56,7 +68,7 @@ public:
     static bool setBranchSyncExcludeFiles(const QString branchName, const QString excludeFilesContent);
     static bool isBranchLocked(const QString branchName);
 
-    static bool getRepos(const QString branchName, QList<Database::RepoInfo> & list);
+    static bool getRepos(const QString branchName, QList<Repo::MetadataPtr> & list, const bool withPackages = true);
     static bool lockRepo(const QString branchName, const QString repoName, const QString repoArchitecture, const int sessionID, const QString username);
     static bool adjustRepoFiles(const QString branchName, const QString repoName, const QString repoArchitecture, const int sessionID, const QStringList & addPackages, const QStringList & removePackages);
     static void releaseRepoLock(const int sessionID);
@@ -64,15 +76,19 @@ public:
     static bool lockPoolFiles(const int sessionID, const QString username, const QStringList & files);
     static bool checkPoolFilesExists(const QStringList & files, QStringList & missingFiles);
     static bool getPoolFileCheckSum(const QString file, QByteArray & checkSum);
-    static bool moveFilesToPool(const int sessionID, const QString path, QStringList files);
+    static bool moveFilesToPool(const int sessionID, const QString path, QStringList files, const QHash<QString, QByteArray> & checkSums);
     static void releasePoolLock(const int sessionID);
+    static bool syncPoolFileExists(const QString file);
+    static void updateSyncPoolFiles(const QStringList & files);
+    static void savePoolIndexes();
 
     static bool synchronizeBranch(const QString branchName, const QString username, int & syncSessionID);
-    static bool snapshotBranch(const QString sourceBranchName, const QString destBranchName, const QString username, const int sessionID);
+    static bool snapshotBranch(const QString sourceBranchName, const QString destBranchName, const QString username, int & snapSessionID);
 
     static void releaseSession(const int sessionID);
 
     static void removeOrphanPoolFiles();
+    static bool migratePools();
 
 private:
     struct PoolLock {
@@ -80,13 +96,58 @@ private:
         QStringList files;
     };
 
-    static QMutex mutex;
+    struct InitResult {
+        bool success;
+        qint64 elapsed;
+
+        InitResult() {
+            success = false;
+            elapsed = 0;
+        }
+    };
+
+    class InitJob : public QRunnable
+    {
+    public:
+        InitJob(Branch *branch, Repo *repo, InitResult *result) : branch(branch), repo(repo), result(result) {}
+        void run();
+
+    private:
+        Branch *branch;
+        Repo *repo;
+        InitResult *result;
+    };
+
+    class SnapshotJob : public QRunnable
+    {
+    public:
+        SnapshotJob(Branch *sourceBranch, Branch *destBranch, const QString username, const int sessionID) :
+            sourceBranch(sourceBranch), destBranch(destBranch), username(username), sessionID(sessionID) {}
+        void run() { Database::runSnapshot(sourceBranch, destBranch, username, sessionID); }
+
+    private:
+        Branch *sourceBranch, *destBranch;
+        const QString username;
+        const int sessionID;
+    };
+
+    static QMutex syncMutex;
+    static QReadWriteLock branchesLock, poolLock;
     static Sync sync;
     static QList<Branch*> branches;
     static QMap<int, PoolLock> lockedPoolFiles;
-    static QStringList poolFiles;
-
-    static void _keepOrphanFiles(QStringList & files, const QStringList & checkPackages);
+    static PoolIndex *overlayPool, *syncPool;
+    static QThreadPool snapshotPool;
+
+    static void runSnapshot(Branch *sourceBranch, Branch *destBranch, const QString username, const int sessionID);
+    static void getSnapshotChanges(Branch *sourceBranch, Branch *destBranch, QList<Global::RepoChanges> & repoChangesList);
+    static bool cloneBranch(Branch *sourceBranch, Branch *destBranch);
+
+    static bool _countPoolReferences();
+    static void _addOrphanCandidates(PoolIndex *pool, const bool syncPool);
+    static bool _removeOrphanFile(PoolIndex *pool, const PoolReferences::Candidate & candidate, const qint64 maxTime, const quint64 protectedGeneration);
+    static void _importPool(PoolIndex *pool);
+    static bool _migratePool(const QString poolPath);
     static Branch* _getBranch(const QString branchName);
     static Repo* _getRepo(const QString branchName, const QString repoName, const QString repoArchitecture);
     static void _releaseRepoLock(const int sessionID);
@@ -0,0 +1,180 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "packagelistfile.h"
+
+
+
+bool PackageListFile::read(const QString path, QStringList & packages) {
+    struct stat source;
+
+    packages.clear();
+
+    if (stat(QFile::encodeName(path).constData(), &source) != 0)
+        return false;
+
+    // Use the sidecar if it is up to date. Its strings are interned while reading.
+    if (readSidecar(sidecarPath(path), source, packages))
+        return true;
+
+    if (!readText(path, packages))
+        return false;
+
+    // The same package files are listed by several branches
+    StringPool::intern(packages);
+
+    // Rebuild the stale sidecar. Error isn't critical.
+    writeSidecar(path, packages);
+
+    return true;
+}
+
+
+
+bool PackageListFile::write(const QString path, const QStringList & packages) {
+    QStringList sorted = packages;
+    QByteArray data;
+
+    sorted.sort();
+
+    foreach (const QString package, sorted)
+        data.append(package.toUtf8() + "\n");
+
+    // The sidecar isn't written here. Written lists stay loaded and
+    // the sidecar is only rebuilt if the list is read again.
+    return Global::writeFileAtomic(path, data);
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+bool PackageListFile::readSidecar(const QString path, const struct stat & source, QStringList & packages) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(Header))
+        return false;
+
+    const qint64 size = file.size();
+    const uchar *data = file.map(0, size);
+    if (!data)
+        return false;
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+
+    // Validate the header and the offsets table
+    const qint64 tableSize = ((qint64)header.count + 1) * sizeof(quint32);
+
+    if (memcmp(header.magic, BOXIT_PACKAGE_LIST_MAGIC, 4) != 0
+            || header.version != BOXIT_PACKAGE_LIST_VERSION
+            || header.sourceSize != (quint64)source.st_size
+            || header.sourceMTime != (qint64)source.st_mtim.tv_sec
+            || header.sourceMTimeNSec != (qint64)source.st_mtim.tv_nsec
+            || (qint64)sizeof(Header) + tableSize > size) {
+        file.unmap((uchar*)data);
+        return false;
+    }
+
+    const quint32 *offsets = (const quint32*)(data + sizeof(Header));
+    const char *strings = (const char*)(data + sizeof(Header) + tableSize);
+    const qint64 stringsSize = size - sizeof(Header) - tableSize;
+
+    if (offsets[0] != 0 || offsets[header.count] > stringsSize) {
+        file.unmap((uchar*)data);
+        return false;
+    }
+
+    packages.reserve(header.count);
+
+    for (quint32 i = 0; i < header.count; ++i) {
+        if (offsets[i + 1] < offsets[i]) {
+            packages.clear();
+            file.unmap((uchar*)data);
+            return false;
+        }
+
+        packages.append(StringPool::intern(strings + offsets[i], offsets[i + 1] - offsets[i]));
+    }
+
+    file.unmap((uchar*)data);
+
+    return true;
+}
+
+
+
+bool PackageListFile::writeSidecar(const QString path, const QStringList & packages) {
+    struct stat source;
+    if (stat(QFile::encodeName(path).constData(), &source) != 0)
+        return false;
+
+    QStringList sorted = packages;
+    sorted.sort();
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, BOXIT_PACKAGE_LIST_MAGIC, 4);
+    header.version = BOXIT_PACKAGE_LIST_VERSION;
+    header.sourceSize = source.st_size;
+    header.sourceMTime = source.st_mtim.tv_sec;
+    header.sourceMTimeNSec = source.st_mtim.tv_nsec;
+    header.count = sorted.size();
+
+    QByteArray strings;
+    QByteArray offsets;
+    quint32 offset = 0;
+
+    offsets.append((const char*)&offset, sizeof(quint32));
+
+    foreach (const QString package, sorted) {
+        strings.append(package.toUtf8());
+        offset = strings.size();
+        offsets.append((const char*)&offset, sizeof(quint32));
+    }
+
+    return Global::writeFileAtomic(sidecarPath(path), QByteArray((const char*)&header, sizeof(Header)) + offsets + strings);
+}
+
+
+
+bool PackageListFile::readText(const QString path, QStringList & packages) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        packages.append(line);
+    }
+
+    file.close();
+
+    packages.sort();
+
+    return true;
+}
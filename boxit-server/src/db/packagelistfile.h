@@ -0,0 +1,64 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKAGELISTFILE_H
+#define PACKAGELISTFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QByteArray>
+#include <sys/stat.h>
+#include <string.h>
+
+#include "global.h"
+#include "const.h"
+#include "stringpool.h"
+
+
+// Package list files (.overlaypackages, .syncpackages) with a binary sidecar.
+// The text file is the source of truth. The sidecar is a sorted string table
+// which is memory mapped and read without any text parsing. It records the
+// size and modification time of the text file and is ignored as soon as they
+// don't match anymore. Writes only replace the text file. A stale sidecar is
+// rebuilt by the next read.
+class PackageListFile
+{
+public:
+    static bool read(const QString path, QStringList & packages);
+    static bool write(const QString path, const QStringList & packages);
+
+private:
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint64 sourceSize;
+        qint64 sourceMTime, sourceMTimeNSec;
+        quint32 count, reserved;
+    };
+
+    static QString sidecarPath(const QString path) { return path + BOXIT_PACKAGE_LIST_SIDECAR_ENDING; }
+    static bool readSidecar(const QString path, const struct stat & source, QStringList & packages);
+    static bool writeSidecar(const QString path, const QStringList & packages);
+    static bool readText(const QString path, QStringList & packages);
+};
+
+#endif // PACKAGELISTFILE_H
@@ -0,0 +1,99 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "packageset.h"
+
+
+PackageSet::PackageSet()
+{
+}
+
+
+
+PackageSet::PackageSet(const QStringList & files)
+{
+    packages.reserve(files.size());
+    this->files.reserve(files.size());
+
+    foreach (const QString file, files)
+        insert(file);
+}
+
+
+
+void PackageSet::insert(const QString file) {
+    insert(Global::getNameofPKG(file), Global::getVersionofPKG(file), file);
+}
+
+
+
+void PackageSet::insert(const QString name, const QString version, const QString file) {
+    // A package with the same name is replaced
+    remove(name);
+
+    Package package;
+    package.name = name;
+    package.version = version;
+    package.file = file;
+
+    packages.insert(name, package);
+
+    if (!file.isEmpty())
+        files.insert(file);
+}
+
+
+
+void PackageSet::remove(const QString name) {
+    QHash<QString, Package>::iterator it = packages.find(name);
+    if (it == packages.end())
+        return;
+
+    files.remove(it.value().file);
+    packages.erase(it);
+}
+
+
+
+bool PackageSet::contains(const QString name, const QString version) const {
+    QHash<QString, Package>::const_iterator it = packages.constFind(name);
+
+    return (it != packages.constEnd() && it.value().version == version);
+}
+
+
+
+QStringList PackageSet::difference(const QStringList & list, const QStringList & subtract) {
+    // All items of list which aren't in subtract. Keeps the order of list.
+    QSet<QString> subtractSet;
+    subtractSet.reserve(subtract.size());
+
+    foreach (const QString item, subtract)
+        subtractSet.insert(item);
+
+    QStringList result;
+
+    foreach (const QString item, list) {
+        if (!subtractSet.contains(item))
+            result.append(item);
+    }
+
+    return result;
+}
@@ -0,0 +1,61 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKAGESET_H
+#define PACKAGESET_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+#include "global.h"
+
+
+// Hash indexed set of packages: package name -> version and file.
+// Lookups by name, by name and version and by file name are O(1).
+class PackageSet
+{
+public:
+    struct Package {
+        QString name, version, file;
+    };
+
+    PackageSet();
+    explicit PackageSet(const QStringList & files);
+
+    void insert(const QString file);
+    void insert(const QString name, const QString version, const QString file);
+    void remove(const QString name);
+
+    bool contains(const QString name, const QString version) const;
+    bool containsName(const QString name) const     { return packages.contains(name); }
+    bool containsFile(const QString file) const     { return files.contains(file); }
+    Package value(const QString name) const         { return packages.value(name); }
+    int size() const                                { return packages.size(); }
+
+    static QStringList difference(const QStringList & list, const QStringList & subtract);
+
+private:
+    QHash<QString, Package> packages;
+    QSet<QString> files;
+};
+
+#endif // PACKAGESET_H
@@ -0,0 +1,235 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallelgzip.h"
+
+
+
+QThreadPool ParallelGzip::pool;
+int ParallelGzip::level = BOXIT_DEFAULT_DB_COMPRESSION_LEVEL;
+
+
+
+ParallelGzip::ParallelGzip()
+{
+    crc = crc32(0L, Z_NULL, 0);
+    inputSize = 0;
+}
+
+
+
+ParallelGzip::~ParallelGzip() {
+    if (file.isOpen())
+        file.close();
+}
+
+
+
+void ParallelGzip::init() {
+    Global::Config config = Global::getConfig();
+
+    if (config.dbCompressionThreads > 0)
+        pool.setMaxThreadCount(config.dbCompressionThreads);
+    else
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+
+    level = config.dbCompressionLevel;
+}
+
+
+
+bool ParallelGzip::open(const QString path) {
+    errorString.clear();
+    blocks.clear();
+    input.clear();
+    dictionary.clear();
+    crc = crc32(0L, Z_NULL, 0);
+    inputSize = 0;
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorString = QString("failed to open '%1'").arg(path);
+        return false;
+    }
+
+    // gzip header: deflate, no flags, no modification time, unix
+    const char header[10] = { '\x1f', '\x8b', '\x08', 0, 0, 0, 0, 0, 0, '\x03' };
+
+    return writeData(QByteArray(header, sizeof(header)));
+}
+
+
+
+bool ParallelGzip::write(const char *data, const qint64 size) {
+    qint64 pos = 0;
+
+    while (pos < size) {
+        qint64 length = qMin(size - pos, (qint64)BOXIT_GZIP_BLOCK_SIZE - input.size());
+        input.append(data + pos, length);
+        pos += length;
+
+        if (input.size() >= BOXIT_GZIP_BLOCK_SIZE && !queueBlock(false))
+            return false;
+    }
+
+    inputSize += (quint32)size;
+
+    return true;
+}
+
+
+
+bool ParallelGzip::close() {
+    if (!file.isOpen())
+        return errorString.isEmpty();
+
+    // The last block terminates the deflate stream
+    if (!queueBlock(true) || !writeBlocks()) {
+        file.close();
+        return false;
+    }
+
+    // gzip trailer: crc32 and input size, little endian
+    char trailer[8];
+    for (int i = 0; i < 4; ++i) {
+        trailer[i] = (char)((crc >> (8 * i)) & 0xff);
+        trailer[i + 4] = (char)((inputSize >> (8 * i)) & 0xff);
+    }
+
+    bool success = writeData(QByteArray(trailer, sizeof(trailer)));
+    file.close();
+
+    return success;
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+bool ParallelGzip::queueBlock(const bool last) {
+    Block block;
+    block.input = input;
+    block.dictionary = dictionary;
+    block.last = last;
+    blocks.append(block);
+
+    dictionary = input.right(BOXIT_GZIP_DICTIONARY_SIZE);
+    input.clear();
+
+    // Compress a batch as soon as every worker has a block
+    if (last || blocks.size() >= pool.maxThreadCount())
+        return writeBlocks();
+
+    return true;
+}
+
+
+
+bool ParallelGzip::writeBlocks() {
+    if (blocks.isEmpty())
+        return true;
+
+    QSemaphore done;
+
+    for (int i = 0; i < blocks.size(); ++i)
+        pool.start(new Job(&blocks[i], &done));
+
+    done.acquire(blocks.size());
+
+    // Write the compressed blocks in order
+    for (int i = 0; i < blocks.size(); ++i) {
+        const Block & block = blocks.at(i);
+
+        if (block.error) {
+            errorString = QString("failed to compress '%1'").arg(file.fileName());
+            blocks.clear();
+            return false;
+        }
+
+        if (!writeData(block.output)) {
+            blocks.clear();
+            return false;
+        }
+
+        crc = crc32_combine(crc, block.crc, block.input.size());
+    }
+
+    blocks.clear();
+
+    return true;
+}
+
+
+
+bool ParallelGzip::writeData(const QByteArray & data) {
+    if (file.write(data) == data.size())
+        return true;
+
+    errorString = QString("failed to write '%1'").arg(file.fileName());
+    return false;
+}
+
+
+
+void ParallelGzip::compressBlock(Block & block) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    block.crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)block.input.constData(), block.input.size());
+
+    // Raw deflate. The gzip header and trailer are written by the caller.
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        block.error = true;
+        return;
+    }
+
+    if (!block.dictionary.isEmpty())
+        deflateSetDictionary(&stream, (const Bytef*)block.dictionary.constData(), block.dictionary.size());
+
+    const int flush = block.last ? Z_FINISH : Z_SYNC_FLUSH;
+    qint64 written = 0;
+    int ret;
+
+    stream.next_in = (Bytef*)block.input.data();
+    stream.avail_in = block.input.size();
+    block.output.resize(deflateBound(&stream, block.input.size()) + 64);
+
+    do {
+        if (written >= block.output.size())
+            block.output.resize(block.output.size() * 2);
+
+        stream.next_out = (Bytef*)block.output.data() + written;
+        stream.avail_out = block.output.size() - written;
+
+        ret = deflate(&stream, flush);
+        written = block.output.size() - stream.avail_out;
+    } while (ret == Z_OK && stream.avail_out == 0);
+
+    deflateEnd(&stream);
+
+    block.output.resize(written);
+    block.error = block.last ? (ret != Z_STREAM_END) : (ret != Z_OK && ret != Z_BUF_ERROR);
+}
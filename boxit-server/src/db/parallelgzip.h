@@ -0,0 +1,95 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLELGZIP_H
+#define PARALLELGZIP_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <zlib.h>
+
+#include "global.h"
+#include "const.h"
+#include "compressedfile.h"
+
+
+// pigz style gzip writer. The input is split into blocks which are deflated
+// in parallel. Every block is primed with the last 32K of the previous block
+// and ends with a sync flush, so the concatenated blocks form one regular
+// gzip member which any gzip reader, including pacman, understands.
+class ParallelGzip : public CompressedFile
+{
+public:
+    ParallelGzip();
+    ~ParallelGzip();
+
+    static void init();
+
+    bool open(const QString path);
+    bool write(const char *data, const qint64 size);
+    bool close();
+
+private:
+    struct Block {
+        QByteArray input, dictionary, output;
+        uLong crc;
+        bool last, error;
+
+        Block() {
+            crc = 0;
+            last = false;
+            error = false;
+        }
+    };
+
+    class Job : public QRunnable
+    {
+    public:
+        Job(Block *block, QSemaphore *done) : block(block), done(done) {}
+        void run() { ParallelGzip::compressBlock(*block); done->release(); }
+
+    private:
+        Block *block;
+        QSemaphore *done;
+    };
+
+    static QThreadPool pool;
+    static int level;
+
+    QFile file;
+    QList<Block> blocks;
+    QByteArray input, dictionary;
+    uLong crc;
+    quint32 inputSize;
+
+    bool queueBlock(const bool last);
+    bool writeBlocks();
+    bool writeData(const QByteArray & data);
+
+    static void compressBlock(Block & block);
+};
+
+#endif // PARALLELGZIP_H
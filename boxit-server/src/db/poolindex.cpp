@@ -0,0 +1,305 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "poolindex.h"
+
+
+
+PoolIndex::PoolIndex(const QString poolPath) :
+    poolPath(poolPath),
+    indexPath(QFileInfo(poolPath).absolutePath() + "/." + QFileInfo(poolPath).fileName() + BOXIT_POOL_INDEX_ENDING)
+{
+    modified = false;
+    misplacedEntries = 0;
+}
+
+
+
+bool PoolIndex::load() {
+    entries.clear();
+    modified = false;
+    misplacedEntries = 0;
+
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return scan();
+
+    // First line: version and pool directory stamp
+    QTextStream in(&file);
+    QStringList header = in.readLine().split(" ", QString::SkipEmptyParts);
+
+    if (header.size() != 2 || header.at(0).toInt() != BOXIT_POOL_INDEX_VERSION || header.at(1) != directoryStamp()) {
+        file.close();
+        return scan();
+    }
+
+    // Each line: name size mtime mtimeNSec inode sha1
+    while (!in.atEnd()) {
+        QStringList fields = in.readLine().split("\t");
+        if (fields.size() != 6) {
+            file.close();
+            return scan();
+        }
+
+        Entry entry;
+        entry.size = fields.at(1).toLongLong();
+        entry.mtime = fields.at(2).toLongLong();
+        entry.mtimeNSec = fields.at(3).toLongLong();
+        entry.inode = fields.at(4).toULongLong();
+
+        if (fields.at(5) != "-")
+            entry.sha1 = QByteArray::fromHex(fields.at(5).toLatin1());
+
+        entries.insert(fields.at(0), entry);
+    }
+
+    file.close();
+
+    return true;
+}
+
+
+
+bool PoolIndex::save() {
+    // The index would hide the misplaced files on the next start
+    if (misplacedEntries > 0)
+        return false;
+
+    // Take the stamp first. Later changes make the saved index stale.
+    QByteArray data = QString(QString::number(BOXIT_POOL_INDEX_VERSION) + " " + directoryStamp() + "\n").toUtf8();
+
+    QHash<QString, Entry>::const_iterator it = entries.constBegin();
+    while (it != entries.constEnd()) {
+        const Entry & entry = it.value();
+
+        data.append(QString("%1\t%2\t%3\t%4\t%5\t%6\n").arg(it.key(), QString::number(entry.size), QString::number(entry.mtime),
+                                                          QString::number(entry.mtimeNSec), QString::number(entry.inode),
+                                                          entry.sha1.isEmpty() ? QString("-") : QString(entry.sha1.toHex())).toUtf8());
+        ++it;
+    }
+
+    if (!Global::writeFileAtomic(indexPath, data))
+        return false;
+
+    modified = false;
+
+    return true;
+}
+
+
+
+bool PoolIndex::scan() {
+    // Keep the checksums of unchanged files
+    QHash<QString, Entry> oldEntries = entries;
+    bool success = true;
+
+    entries.clear();
+    modified = true;
+    misplacedEntries = 0;
+
+    if (!Global::getConfig().shardedPool) {
+        // Shard directories are left over from the sharded layout
+        success = scanDirectory(poolPath, oldEntries, misplacedEntries);
+    }
+    else {
+        // Only the shard directories hold pool files
+        QStringList shards = QDir(poolPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        misplacedEntries = QDir(poolPath).entryList(QDir::Files | QDir::NoDotAndDotDot).size();
+
+        foreach (const QString shard, shards) {
+            int subShards;
+
+            if (shard.length() == BOXIT_POOL_SHARD_LENGTH && !scanDirectory(poolPath + "/" + shard, oldEntries, subShards))
+                success = false;
+        }
+    }
+
+    return success;
+}
+
+
+
+bool PoolIndex::update(const QString file, const QByteArray & checkSum) {
+    Entry entry;
+
+    if (!statFile(Global::poolFilePath(poolPath, file), entry)) {
+        remove(file);
+        return false;
+    }
+
+    // Keep the checksum if the file didn't change
+    QHash<QString, Entry>::const_iterator it = entries.constFind(file);
+
+    if (!checkSum.isEmpty())
+        entry.sha1 = checkSum;
+    else if (it != entries.constEnd() && sameFile(it.value(), entry))
+        entry.sha1 = it.value().sha1;
+
+    entries.insert(file, entry);
+    modified = true;
+
+    return true;
+}
+
+
+
+void PoolIndex::remove(const QString file) {
+    if (entries.remove(file) > 0)
+        modified = true;
+}
+
+
+
+bool PoolIndex::get(const QString file, PoolIndex::Entry & entry) const {
+    QHash<QString, Entry>::const_iterator it = entries.constFind(file);
+    if (it == entries.constEnd())
+        return false;
+
+    entry = it.value();
+
+    return true;
+}
+
+
+
+bool PoolIndex::getCheckSum(const QString file, QByteArray & checkSum) const {
+    QHash<QString, Entry>::const_iterator it = entries.constFind(file);
+    if (it == entries.constEnd() || it.value().sha1.isEmpty())
+        return false;
+
+    // Validate the cached checksum. A stat is cheap compared to hashing the file.
+    Entry entry;
+    if (!statFile(Global::poolFilePath(poolPath, file), entry) || !sameFile(it.value(), entry))
+        return false;
+
+    checkSum = it.value().sha1;
+
+    return true;
+}
+
+
+
+void PoolIndex::setCheckSum(const QString file, const PoolIndex::Entry & fileInfo, const QByteArray & checkSum) {
+    if (!entries.contains(file) || checkSum.isEmpty())
+        return;
+
+    // fileInfo is the state of the file when it was hashed
+    Entry entry = fileInfo;
+    entry.sha1 = checkSum;
+
+    entries.insert(file, entry);
+    modified = true;
+}
+
+
+
+bool PoolIndex::statFile(const QString path, PoolIndex::Entry & entry) {
+    struct stat info;
+
+    // Only regular files. Symlinks and directories aren't pool files.
+    if (lstat(QFile::encodeName(path).constData(), &info) != 0 || !S_ISREG(info.st_mode))
+        return false;
+
+    entry.size = info.st_size;
+    entry.mtime = info.st_mtim.tv_sec;
+    entry.mtimeNSec = info.st_mtim.tv_nsec;
+    entry.inode = info.st_ino;
+
+    return true;
+}
+
+
+
+bool PoolIndex::sameFile(const PoolIndex::Entry & entry1, const PoolIndex::Entry & entry2) {
+    return (entry1.inode == entry2.inode && entry1.size == entry2.size
+            && entry1.mtime == entry2.mtime && entry1.mtimeNSec == entry2.mtimeNSec);
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+bool PoolIndex::scanDirectory(const QString path, const QHash<QString, PoolIndex::Entry> & oldEntries, int & shards) {
+    shards = 0;
+
+    const QByteArray encodedPath = QFile::encodeName(path);
+    DIR *dir = opendir(encodedPath.constData());
+    if (!dir)
+        return false;
+
+    struct dirent *ent;
+
+    while ((ent = readdir(dir)) != NULL) {
+        // Skip hidden files
+        if (ent->d_name[0] == '.')
+            continue;
+
+        const QString file = QFile::decodeName(ent->d_name);
+        Entry entry;
+
+        if (!statFile(path + "/" + file, entry)) {
+            if (file.length() == BOXIT_POOL_SHARD_LENGTH && QFileInfo(path + "/" + file).isDir())
+                ++shards;
+
+            continue;
+        }
+
+        QHash<QString, Entry>::const_iterator it = oldEntries.constFind(file);
+        if (it != oldEntries.constEnd() && sameFile(it.value(), entry))
+            entry.sha1 = it.value().sha1;
+
+        entries.insert(file, entry);
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+
+
+QString PoolIndex::directoryStamp() {
+    struct stat info;
+
+    if (stat(QFile::encodeName(poolPath).constData(), &info) != 0)
+        return QString("0");
+
+    QString stamp = QString::number(info.st_mtim.tv_sec) + "." + QString::number(info.st_mtim.tv_nsec);
+
+    if (!Global::getConfig().shardedPool)
+        return stamp;
+
+    // Files are added to the shard directories. Their modification times are part of the stamp.
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QStringList shards = QDir(poolPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+
+    foreach (const QString shard, shards) {
+        if (stat(QFile::encodeName(poolPath + "/" + shard).constData(), &info) != 0)
+            continue;
+
+        hash.addData(QString(shard + ":" + QString::number(info.st_mtim.tv_sec) + "." + QString::number(info.st_mtim.tv_nsec) + ";").toUtf8());
+    }
+
+    return "sharded:" + stamp + ":" + QString(hash.result().toHex());
+}
@@ -0,0 +1,99 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOLINDEX_H
+#define POOLINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <iostream>
+
+#include "global.h"
+#include "const.h"
+
+using namespace std;
+
+
+// Hash index of the files of a package pool with their size, modification
+// time, inode and SHA1 checksum. The index is saved as a hidden file next to the pool
+// directory and is loaded on startup instead of scanning the pool. It is
+// trusted as long as the modification time of the pool directory matches
+// the saved one. Checksums are only valid as long as the inode, size and
+// modification time of the file match. They are kept on rescans.
+// Files and shard directories outside of the configured pool layout aren't
+// indexed. They are counted by the scan and such an index is never saved.
+// Not thread safe: the owner has to lock it.
+class PoolIndex
+{
+public:
+    struct Entry {
+        qint64 size, mtime, mtimeNSec;
+        quint64 inode;
+        QByteArray sha1;
+
+        Entry() {
+            size = 0;
+            mtime = 0;
+            mtimeNSec = 0;
+            inode = 0;
+        }
+    };
+
+    PoolIndex(const QString poolPath);
+
+    bool load();
+    bool save();
+    bool scan();
+    bool update(const QString file, const QByteArray & checkSum = QByteArray());
+    void remove(const QString file);
+
+    bool contains(const QString file) const             { return entries.contains(file); }
+    bool get(const QString file, PoolIndex::Entry & entry) const;
+    bool getCheckSum(const QString file, QByteArray & checkSum) const;
+    void setCheckSum(const QString file, const PoolIndex::Entry & fileInfo, const QByteArray & checkSum);
+    QStringList files() const                           { return entries.keys(); }
+    int size() const                                    { return entries.size(); }
+    bool isModified() const                             { return modified; }
+    int getMisplacedEntries() const                       { return misplacedEntries; }
+    QString getPoolPath() const                         { return poolPath; }
+
+    static bool statFile(const QString path, PoolIndex::Entry & entry);
+    static bool sameFile(const PoolIndex::Entry & entry1, const PoolIndex::Entry & entry2);
+
+private:
+    const QString poolPath, indexPath;
+    QHash<QString, PoolIndex::Entry> entries;
+    bool modified;
+    int misplacedEntries;
+
+    bool scanDirectory(const QString path, const QHash<QString, PoolIndex::Entry> & oldEntries, int & shards);
+    QString directoryStamp();
+};
+
+#endif // POOLINDEX_H
@@ -0,0 +1,293 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "poolreferences.h"
+
+
+
+QMutex PoolReferences::mutex;
+quint64 PoolReferences::epoch = 1;
+quint64 PoolReferences::generation = 1;
+bool PoolReferences::valid = true;
+bool PoolReferences::candidatesQueued = false;
+QHash<const void*, quint64> PoolReferences::pins;
+QHash<QString, int> PoolReferences::overlayReferences;
+QHash<QString, int> PoolReferences::syncReferences;
+QHash<QString, quint64> PoolReferences::overlayTouched;
+QHash<QString, quint64> PoolReferences::syncTouched;
+QMultiMap<qint64, PoolReferences::Candidate> PoolReferences::candidates;
+
+
+
+void PoolReferences::clear() {
+    QMutexLocker locker(&mutex);
+
+    overlayReferences.clear();
+    syncReferences.clear();
+    overlayTouched.clear();
+    syncTouched.clear();
+    candidates.clear();
+
+    // No repository is counted anymore
+    ++epoch;
+    valid = true;
+    candidatesQueued = false;
+}
+
+
+
+quint64 PoolReferences::beginCount() {
+    QMutexLocker locker(&mutex);
+
+    // Count all repositories again
+    if (!valid) {
+        overlayReferences.clear();
+        syncReferences.clear();
+
+        ++epoch;
+        valid = true;
+        candidatesQueued = false;
+    }
+
+    return epoch;
+}
+
+
+
+bool PoolReferences::finishCount(const quint64 countEpoch, bool & queueCandidates) {
+    QMutexLocker locker(&mutex);
+
+    queueCandidates = false;
+
+    // Invalidated while counting
+    if (countEpoch != epoch || !valid)
+        return false;
+
+    // Queue all unreferenced files once per epoch
+    queueCandidates = !candidatesQueued;
+    candidatesQueued = true;
+
+    return true;
+}
+
+
+
+void PoolReferences::invalidate(const quint64 countEpoch) {
+    QMutexLocker locker(&mutex);
+
+    if (countEpoch == epoch)
+        valid = false;
+}
+
+
+
+bool PoolReferences::add(const quint64 countEpoch, const QStringList & overlayPackages, const QStringList & syncPackages) {
+    QMutexLocker locker(&mutex);
+
+    // The repository isn't counted in this epoch
+    if (countEpoch != epoch)
+        return false;
+
+    foreach (const QString package, overlayPackages)
+        ++overlayReferences[package];
+
+    foreach (const QString package, syncPackages)
+        ++syncReferences[package];
+
+    return true;
+}
+
+
+
+void PoolReferences::remove(const quint64 countEpoch, const QStringList & overlayPackages, const QStringList & syncPackages) {
+    QMutexLocker locker(&mutex);
+    const qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    if (countEpoch != epoch)
+        return;
+
+    removeReferences(overlayReferences, overlayPackages, false, now);
+    removeReferences(syncReferences, syncPackages, true, now);
+}
+
+
+
+bool PoolReferences::isReferenced(const QString file, const bool syncPool) {
+    QMutexLocker locker(&mutex);
+
+    if (syncPool)
+        return syncReferences.contains(packageName(file));
+    else
+        return overlayReferences.contains(packageName(file));
+}
+
+
+
+void PoolReferences::addCandidate(const QString file, const bool syncPool, const qint64 since) {
+    QMutexLocker locker(&mutex);
+
+    Candidate candidate;
+    candidate.file = file;
+    candidate.syncPool = syncPool;
+
+    candidates.insert(since, candidate);
+}
+
+
+
+void PoolReferences::clearCandidates() {
+    QMutexLocker locker(&mutex);
+    candidates.clear();
+}
+
+
+
+void PoolReferences::takeExpiredCandidates(const qint64 maxTime, QList<PoolReferences::Candidate> & expired) {
+    QMutexLocker locker(&mutex);
+
+    expired.clear();
+
+    // The candidates are sorted by time
+    QMultiMap<qint64, Candidate>::iterator it = candidates.begin();
+
+    while (it != candidates.end() && it.key() <= maxTime) {
+        expired.append(it.value());
+        it = candidates.erase(it);
+    }
+}
+
+
+
+int PoolReferences::candidateCount() {
+    QMutexLocker locker(&mutex);
+    return candidates.size();
+}
+
+
+
+void PoolReferences::pin(const void *owner) {
+    QMutexLocker locker(&mutex);
+
+    // Keep the generation of the first pin
+    if (!pins.contains(owner))
+        pins.insert(owner, generation);
+}
+
+
+
+void PoolReferences::unpin(const void *owner) {
+    QMutexLocker locker(&mutex);
+    pins.remove(owner);
+}
+
+
+
+void PoolReferences::touch(const QString file, const bool syncPool) {
+    QMutexLocker locker(&mutex);
+
+    if (syncPool)
+        syncTouched.insert(packageName(file), generation);
+    else
+        overlayTouched.insert(packageName(file), generation);
+}
+
+
+
+quint64 PoolReferences::beginSweep() {
+    QMutexLocker locker(&mutex);
+
+    // Files touched from now on belong to the new generation
+    quint64 protectedGeneration = ++generation;
+
+    QHash<const void*, quint64>::const_iterator it = pins.constBegin();
+    while (it != pins.constEnd()) {
+        protectedGeneration = qMin(protectedGeneration, it.value());
+        ++it;
+    }
+
+    // Older touches don't protect anything anymore
+    QHash<QString, quint64> *touched[] = { &overlayTouched, &syncTouched };
+
+    for (int i = 0; i < 2; ++i) {
+        QHash<QString, quint64>::iterator it = touched[i]->begin();
+
+        while (it != touched[i]->end()) {
+            if (it.value() < protectedGeneration)
+                it = touched[i]->erase(it);
+            else
+                ++it;
+        }
+    }
+
+    return protectedGeneration;
+}
+
+
+
+bool PoolReferences::isRemovable(const QString file, const bool syncPool, const quint64 protectedGeneration) {
+    QMutexLocker locker(&mutex);
+    const QString package = packageName(file);
+
+    if (syncPool)
+        return (!syncReferences.contains(package) && syncTouched.value(package, 0) < protectedGeneration);
+    else
+        return (!overlayReferences.contains(package) && overlayTouched.value(package, 0) < protectedGeneration);
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+void PoolReferences::removeReferences(QHash<QString, int> & references, const QStringList & packages, const bool syncPool, const qint64 now) {
+    // Requires a locked mutex
+    foreach (const QString package, packages) {
+        QHash<QString, int>::iterator it = references.find(package);
+        if (it == references.end())
+            continue;
+
+        if (--it.value() > 0)
+            continue;
+
+        references.erase(it);
+
+        // The package and its signature are orphans now
+        Candidate candidate;
+        candidate.syncPool = syncPool;
+
+        candidate.file = package;
+        candidates.insert(now, candidate);
+
+        candidate.file = package + BOXIT_SIGNATURE_ENDING;
+        candidates.insert(now, candidate);
+    }
+}
+
+
+
+QString PoolReferences::packageName(const QString file) {
+    if (!file.endsWith(BOXIT_SIGNATURE_ENDING))
+        return file;
+
+    return file.left(file.length() - QString(BOXIT_SIGNATURE_ENDING).length());
+}
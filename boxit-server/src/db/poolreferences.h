@@ -0,0 +1,101 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOLREFERENCES_H
+#define POOLREFERENCES_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMultiMap>
+#include <QList>
+
+#include "global.h"
+#include "const.h"
+
+
+// Reference counts of the pool files. The counts are built lazily by the
+// orphan sweep: it adds the package lists of each repository which isn't
+// counted yet. Only the first sweep after the start reads all lists. Each
+// commit of a counted repository adds and removes the changed references.
+// A package file and its signature are unreferenced as soon as the count
+// drops to zero. They are queued as orphan candidates with the time since
+// they are unreferenced. New pool files are queued until they are referenced.
+// Once all repositories are counted, all unreferenced pool files are queued
+// with their modification time. Signature files share the count of their
+// package.
+//
+// Counts belong to an epoch. A repository which is removed without its
+// package lists in memory invalidates the counts instead of reading its
+// lists again. Stale counts only keep files. The next sweep starts a new
+// epoch and counts all repositories again.
+//
+// The orphan sweep doesn't lock any repository. Files which are used but not
+// referenced yet are protected by generation numbers instead: each sweep
+// starts a new generation. Busy repositories pin the generation in which
+// they became busy and validated pool files are touched with the current
+// generation. A file touched at or after the oldest pinned generation is
+// never removed.
+class PoolReferences
+{
+public:
+    struct Candidate {
+        QString file;
+        bool syncPool;
+
+        Candidate() {
+            syncPool = false;
+        }
+    };
+
+    static void clear();
+    static quint64 beginCount();
+    static bool finishCount(const quint64 countEpoch, bool & queueCandidates);
+    static void invalidate(const quint64 countEpoch);
+    static bool add(const quint64 countEpoch, const QStringList & overlayPackages, const QStringList & syncPackages);
+    static void remove(const quint64 countEpoch, const QStringList & overlayPackages, const QStringList & syncPackages);
+    static bool isReferenced(const QString file, const bool syncPool);
+    static void addCandidate(const QString file, const bool syncPool, const qint64 since);
+    static void clearCandidates();
+    static void takeExpiredCandidates(const qint64 maxTime, QList<PoolReferences::Candidate> & expired);
+    static int candidateCount();
+
+    static void pin(const void *owner);
+    static void unpin(const void *owner);
+    static void touch(const QString file, const bool syncPool);
+    static quint64 beginSweep();
+    static bool isRemovable(const QString file, const bool syncPool, const quint64 protectedGeneration);
+
+private:
+    static QMutex mutex;
+    static quint64 epoch, generation;
+    static bool valid, candidatesQueued;
+    static QHash<const void*, quint64> pins;
+    static QHash<QString, int> overlayReferences, syncReferences;
+    static QHash<QString, quint64> overlayTouched, syncTouched;
+    static QMultiMap<qint64, PoolReferences::Candidate> candidates;
+
+    static void removeReferences(QHash<QString, int> & references, const QStringList & packages, const bool syncPool, const qint64 now);
+    static QString packageName(const QString file);
+};
+
+#endif // POOLREFERENCES_H
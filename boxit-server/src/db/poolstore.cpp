@@ -0,0 +1,205 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "poolstore.h"
+
+
+
+QMutex PoolStore::mutex;
+bool PoolStore::enabled = false;
+QString PoolStore::storePath;
+
+
+
+bool PoolStore::init() {
+    QMutexLocker locker(&mutex);
+
+    enabled = false;
+
+    Global::Config config = Global::getConfig();
+
+    if (!config.poolObjects)
+        return true;
+
+    storePath = QDir::cleanPath(config.poolObjectsDir);
+
+    // Never publish the objects
+    if ((storePath + "/").startsWith(QDir::cleanPath(config.repoDir) + "/")) {
+        cerr << "error: pool object store '" << storePath.toUtf8().data() << "' is inside of the repository folder!" << endl;
+        return false;
+    }
+
+    if (!QDir(storePath).exists() && !QDir().mkpath(storePath)) {
+        cerr << "error: failed to create directory '" << storePath.toUtf8().data() << "'!" << endl;
+        return false;
+    }
+
+    // Hardlinks require the same filesystem
+    struct stat storeInfo, repoInfo;
+
+    if (stat(QFile::encodeName(storePath).constData(), &storeInfo) != 0
+            || stat(QFile::encodeName(config.repoDir).constData(), &repoInfo) != 0
+            || storeInfo.st_dev != repoInfo.st_dev) {
+        cerr << "error: pool object store '" << storePath.toUtf8().data() << "' isn't on the filesystem of the repository folder!" << endl;
+        return false;
+    }
+
+    enabled = true;
+
+    return true;
+}
+
+
+
+bool PoolStore::add(const QString filePath, QString sha256) {
+    if (!enabled)
+        return true;
+
+    // Hash outside of the lock
+    if (sha256.isEmpty())
+        sha256 = CryptSHA256::sha256CheckSum(filePath);
+
+    if (sha256.isEmpty()) {
+        cerr << "error: failed to hash '" << filePath.toUtf8().data() << "'!" << endl;
+        return false;
+    }
+
+    const QString object = objectPath(sha256);
+
+    QMutexLocker locker(&mutex);
+
+    if (!QFile::exists(object)) {
+        // The file becomes the stored object
+        if (!QDir().mkpath(object.section("/", 0, -2))
+                || link(QFile::encodeName(filePath).constData(), QFile::encodeName(object).constData()) != 0) {
+            cerr << "error: failed to store '" << filePath.toUtf8().data() << "'!" << endl;
+            return false;
+        }
+    }
+    else if (!sameFile(filePath, object)) {
+        // Replace the file by a link to the stored object. Rename is atomic.
+        const QByteArray tmpPath = QFile::encodeName(filePath + ".boxit_link");
+
+        unlink(tmpPath.constData());
+
+        if (link(QFile::encodeName(object).constData(), tmpPath.constData()) != 0
+                || rename(tmpPath.constData(), QFile::encodeName(filePath).constData()) != 0) {
+            unlink(tmpPath.constData());
+            cerr << "error: failed to link '" << filePath.toUtf8().data() << "' to the stored object!" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+bool PoolStore::linkObject(const QString sha256, const QString destPath) {
+    if (!enabled || sha256.isEmpty())
+        return false;
+
+    QMutexLocker locker(&mutex);
+
+    return (link(QFile::encodeName(objectPath(sha256)).constData(), QFile::encodeName(destPath).constData()) == 0);
+}
+
+
+
+void PoolStore::importPool(const QString poolPath, const QStringList & files, QStringList & importedFiles) {
+    importedFiles.clear();
+
+    if (!enabled)
+        return;
+
+    int imported = 0;
+
+    foreach (const QString file, files) {
+        const QString filePath = Global::poolFilePath(poolPath, file);
+        struct stat info;
+
+        // Files with more than one link are already stored
+        if (lstat(QFile::encodeName(filePath).constData(), &info) != 0 || !S_ISREG(info.st_mode) || info.st_nlink > 1)
+            continue;
+
+        if (add(filePath)) {
+            importedFiles.append(file);
+            ++imported;
+        }
+    }
+
+    if (imported > 0)
+        cout << "stored " << imported << " file(s) of '" << poolPath.toUtf8().data() << "' in the pool object store" << endl;
+}
+
+
+
+void PoolStore::removeUnusedObjects() {
+    if (!enabled)
+        return;
+
+    QMutexLocker locker(&mutex);
+
+    QStringList dirs = QDir(storePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+
+    foreach (const QString dir, dirs) {
+        const QString dirPath = storePath + "/" + dir;
+        QStringList objects = QDir(dirPath).entryList(QDir::Files | QDir::NoDotAndDotDot);
+
+        foreach (const QString object, objects) {
+            const QString path = dirPath + "/" + object;
+            struct stat info;
+
+            // Only the store itself links to this object
+            if (lstat(QFile::encodeName(path).constData(), &info) != 0 || info.st_nlink > 1)
+                continue;
+
+            if (!QFile::remove(path)) {
+                cerr << "error: failed to remove '" << path.toUtf8().data() << "'!" << endl;
+                continue;
+            }
+        }
+
+        QDir().rmdir(dirPath); // Fails if not empty. Error is not important.
+    }
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+QString PoolStore::objectPath(const QString sha256) {
+    return storePath + "/" + sha256.left(2) + "/" + sha256;
+}
+
+
+
+bool PoolStore::sameFile(const QString path1, const QString path2) {
+    struct stat info1, info2;
+
+    if (stat(QFile::encodeName(path1).constData(), &info1) != 0 || stat(QFile::encodeName(path2).constData(), &info2) != 0)
+        return false;
+
+    return (info1.st_dev == info2.st_dev && info1.st_ino == info2.st_ino);
+}
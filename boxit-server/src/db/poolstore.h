@@ -0,0 +1,71 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOLSTORE_H
+#define POOLSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <iostream>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "global.h"
+#include "const.h"
+#include "sync/sha256/cryptsha256.h"
+
+using namespace std;
+
+
+// Optional content addressed store next to the repository folder.
+// Each object is stored once as <poolObjectsDir>/<xx>/<sha256> and the files
+// of the overlay and sync pool are hardlinks to it. Identical packages of
+// both pools share their data and a package with a known checksum of the
+// sync database is linked instead of being downloaded again. Uploads are
+// only linked to an object after they were received and hashed.
+// The store is outside of the published repository folder, so mirrors
+// don't copy the objects, but on the same filesystem for the hardlinks.
+// Objects without any pool link left are removed by removeUnusedObjects().
+class PoolStore
+{
+public:
+    static bool init();
+    static bool isEnabled()     { return enabled; }
+    static bool add(const QString filePath, QString sha256 = QString());
+    static bool linkObject(const QString sha256, const QString destPath);
+    static void importPool(const QString poolPath, const QStringList & files, QStringList & importedFiles);
+    static void removeUnusedObjects();
+
+private:
+    static QMutex mutex;
+    static bool enabled;
+    static QString storePath;
+
+    static QString objectPath(const QString sha256);
+    static bool sameFile(const QString path1, const QString path2);
+};
+
+#endif // POOLSTORE_H
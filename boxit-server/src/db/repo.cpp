@@ -21,26 +21,41 @@
 #include "repo.h"
 
 Repo::Repo(const QString branchName, const QString name, const QString architecture, const QString path) :
-    QThread(),
+    QObject(),
     branchName(branchName),
     name(name),
     architecture(architecture),
     path(path),
     tmpPath(QString(BOXIT_TMP) + "/" + branchName + "_" + name + "_" + architecture),
-    repoDB(name + QString(BOXIT_DB_ENDING)),
+    repoDB(name + QString(Global::getConfig().zstdDatabases ? BOXIT_ZSTD_DB_ENDING : BOXIT_DB_ENDING)),
     repoDBLink(name + QString(BOXIT_DB_LINK_ENDING)),
-    repoFiles(name + QString(BOXIT_FILES_DB_ENDING)),
-    repoFilesLink(name + QString(BOXIT_FILES_DB_LINK_ENDING))
+    repoFiles(name + QString(Global::getConfig().zstdDatabases ? BOXIT_ZSTD_FILES_DB_ENDING : BOXIT_FILES_DB_ENDING)),
+    repoFilesLink(name + QString(BOXIT_FILES_DB_LINK_ENDING)),
+    newRepoDB(".tmp." + repoDB),
+    newRepoFiles(".tmp." + repoFiles),
+    journal(path + "/" + BOXIT_JOURNAL_FILE)
 {
     moveToThread(qApp->thread());
     setParent(qApp);
 
+    running = false;
     isCommitting = false;
     isSyncRepo = false;
     waitingCommit = false;
+    abortRequested = false;
+    listsLoaded = false;
+    databaseLoaded = false;
+    poolReferenceEpoch = 0;
     lockedSessionID = -1;
     threadSessionID = -1;
 
+    // Files database fragments are cached outside of the cleaned tmp folder.
+    // Nested folders, because branch and repository names may contain any separator.
+    database.setFilesCacheDir(QString(BOXIT_FILES_CACHE_TMP) + "/" + branchName + "/" + name + "/" + architecture);
+
+    // Publish an empty snapshot until the repository is initialized
+    metadata = Repo::MetadataPtr(new Repo::Metadata());
+
     // Create tmp folder if required
     cleanupTmpDir();
 }
@@ -48,6 +63,10 @@ Repo::Repo(const QString branchName, const QString name, const QString architect
 
 
 Repo::~Repo() {
+    RepoCache::remove(this);
+    removePoolReferences();
+    PoolReferences::unpin(this);
+
     if (QDir(tmpPath).exists())
         Global::rmDir(tmpPath); // Error is not important
 }
@@ -55,33 +74,73 @@ Repo::~Repo() {
 
 
 bool Repo::init() {
+    QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
     // Read config
     if (!readConfig())
         return false;
 
     // Cleanup first
+    RepoCache::remove(this);
+    removePoolReferences();
     overlayPackages.clear();
     syncPackages.clear();
     tmpOverlayPackages.clear();
     tmpSyncPackages.clear();
+    database.clear();
+    listsLoaded = false;
+    databaseLoaded = false;
 
-    // Get all overlay packages
-    if (!readPackagesConfig(".overlaypackages", overlayPackages))
+    // The package lists and the package database are loaded on first use.
+    // Only check that the lists exist.
+    if (!QFile::exists(path + "/.overlaypackages"))
         return false;
 
-    // Get all sync packages if this is a sync repo
-    if (isSyncRepo && !readPackagesConfig(".syncpackages", syncPackages))
+    if (isSyncRepo && !QFile::exists(path + "/.syncpackages"))
+        return false;
+
+    publishMetadata();
+
+    // Finish commits interrupted by a crash. Only a replay loads the package lists.
+    // The pool references are counted later by the orphan sweep.
+    if (!replayJournal())
         return false;
 
+    locker.unlock();
+
+    touchCache();
+
     return true;
 }
 
 
 
-bool Repo::setNewRandomState() {
+Repo::MetadataPtr Repo::getMetadata(const bool withPackages) {
+    Repo::MetadataPtr current = currentMetadata();
+
+    if (!withPackages)
+        return current;
+
+    // Load the package lists on first use
+    if (!current->packagesLoaded) {
+        QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
+        if (!loadPackageLists())
+            cerr << "warning: failed to read package lists of '" << path.toUtf8().data() << "'!" << endl;
+
+        current = currentMetadata();
+    }
+
+    touchCache();
+
+    return current;
+}
+
+
+
+QString Repo::newRandomState() {
     // Create new state
-    state = QString(QCryptographicHash::hash(QString(state + QDateTime::currentDateTimeUtc().toString(Qt::ISODate) + QString::number(qrand())).toLocal8Bit(), QCryptographicHash::Sha1).toHex());
-    return updateConfig();
+    return QString(QCryptographicHash::hash(QString(state + QDateTime::currentDateTimeUtc().toString(Qt::ISODate) + QString::number(qrand())).toLocal8Bit(), QCryptographicHash::Sha1).toHex());
 }
 
 
@@ -95,8 +154,19 @@ bool Repo::adjustPackages(const QStringList & addPackages, const QStringList & r
         return false;
 
     // Create a temporary list ot overlay files
-    tmpOverlayPackages = overlayPackages;
-    tmpSyncPackages = syncPackages;
+    {
+        QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
+        if (!loadPackageLists()) {
+            cerr << "error: failed to read package lists of '" << path.toUtf8().data() << "'!" << endl;
+            return false;
+        }
+
+        tmpOverlayPackages = overlayPackages;
+        tmpSyncPackages = syncPackages;
+    }
+
+    touchCache();
 
     QStringList *workPackages;
     if (workWithSyncPackage)
@@ -110,12 +180,14 @@ bool Repo::adjustPackages(const QStringList & addPackages, const QStringList & r
         workPackages->removeAll(removePackage);
 
     // Add all new files
-    workPackages->append(addPackages);
+    QStringList newPackages = addPackages;
+    StringPool::intern(newPackages);
+    workPackages->append(newPackages);
 
     // Remove duplicates
     workPackages->removeDuplicates();
 
-    // Start thread
+    // Queue the commit process
     start();
 
     return true;
@@ -123,6 +195,28 @@ bool Repo::adjustPackages(const QStringList & addPackages, const QStringList & r
 
 
 
+bool Repo::relinkPackages() {
+    QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
+    // Used after the pool layout changed. Only the package symlinks are retargeted.
+    if (!loadPackageLists()) {
+        cerr << "error: failed to read package lists of '" << path.toUtf8().data() << "'!" << endl;
+        return false;
+    }
+
+    QList<Package> packages;
+    getPackages(overlayPackages, syncPackages, packages);
+
+    if (!applySymlinks(packages, path, "../../..")) {
+        cerr << threadErrorString.toUtf8().data() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+
 bool Repo::lock(const int sessionID, const QString username) {
     if (isLocked())
         return false;
@@ -130,6 +224,9 @@ bool Repo::lock(const int sessionID, const QString username) {
     lockedSessionID = sessionID;
     lockedUsername = username;
 
+    // Protect the pool files used by this session from the orphan sweep until they are committed
+    PoolReferences::pin(this);
+
     return true;
 }
 
@@ -138,6 +235,10 @@ bool Repo::lock(const int sessionID, const QString username) {
 void Repo::unlock() {
     lockedSessionID = -1;
     lockedUsername.clear();
+
+    // A running job unpins when it is done
+    if (!isRunning())
+        PoolReferences::unpin(this);
 }
 
 
@@ -148,43 +249,51 @@ bool Repo::isLocked() {
 
 
 
-void Repo::start() {
-    isCommitting = false;
-    waitingCommit = false;
-    threadErrorString.clear();
-    threadSessionID = lockedSessionID;
-    threadUsername = lockedUsername;
-    QThread::start();
+bool Repo::isRunning() {
+    QMutexLocker locker(&mutexJobState);
+    return running;
+}
+
+
+
+bool Repo::waitingForCommit() {
+    QMutexLocker locker(&mutexJobState);
+    return waitingCommit;
 }
 
 
 
 bool Repo::commit() {
+    QMutexLocker locker(&mutexJobState);
+
     if (!waitingCommit)
         return false;
 
-    // Wake up thread
-    waitCondition.wakeAll();
+    waitingCommit = false;
+    isCommitting = true;
+
+    // Queue the commit job
+    CommitScheduler::submit(this, CommitScheduler::JOB_COMMIT);
 
     return true;
 }
 
 
+
 void Repo::abort() {
-    if (!isRunning() || isCommitting)
-        return;
+    QMutexLocker locker(&mutexJobState);
 
-    // Terminate thread
-    terminate();
-    wait();
+    if (!running || isCommitting)
+        return;
 
-    mutexWaitCondition.unlock();
-    waitingCommit = false;
-    threadSessionID = -1;
-    threadUsername.clear();
+    // A queued or running prepare job cancels itself as soon as possible
+    if (!waitingCommit) {
+        abortRequested = true;
+        return;
+    }
 
-    // Status update
-    Status::setRepoStateChanged(branchName, name, architecture, "process canceled", "Process canceled due to a process failure of another repository process with the same session ID.", Status::STATE_FAILED);
+    // Nothing is running. Cancel right away.
+    cancelJob();
 }
 
 
@@ -195,227 +304,612 @@ void Repo::abort() {
 
 
 
-void Repo::run() {
+void Repo::start() {
+    // Join the commit barrier of the session first
+    emit threadStarted(this, lockedSessionID);
+
+    QMutexLocker locker(&mutexJobState);
+
+    running = true;
+    isCommitting = false;
+    waitingCommit = false;
+    abortRequested = false;
+    threadErrorString.clear();
+    threadSessionID = lockedSessionID;
+    threadUsername = lockedUsername;
+
+    // Status update
+    Status::setRepoStateChanged(branchName, name, architecture, "waiting for a free worker", "", Status::STATE_WAITING);
+
+    // Queue the prepare job
+    CommitScheduler::submit(this, CommitScheduler::JOB_PREPARE);
+}
+
+
+
+void Repo::prepare() {
+    if (checkAbortRequested())
+        return;
+
     // Status update
     Status::setRepoStateChanged(branchName, name, architecture, "applying changes", "", Status::STATE_RUNNING);
 
-    // Wait a little to be sure the remote client is ready
-    sleep(2);
+    // Get the new packages list
+    getPackages(tmpOverlayPackages, tmpSyncPackages, tmpPackages);
 
-    QList<Package> packages;
-    QStringList addPackages, removePackages;
 
-    // Add overlay packages
-    foreach (const QString package, tmpOverlayPackages) {
-        Package pkg;
-        pkg.file = package;
-        pkg.name = Global::getNameofPKG(package);
-        pkg.version = Global::getVersionofPKG(package);
-        pkg.link = QString(BOXIT_OVERLAY_POOL) + "/" + package;
-        pkg.isOverlayPackage = true;
+    // Get a list of all added and removed packages
+    tmpAddPackages = PackageSet::difference(tmpSyncPackages, syncPackages) + PackageSet::difference(tmpOverlayPackages, overlayPackages);
+    tmpRemovePackages = PackageSet::difference(syncPackages, tmpSyncPackages) + PackageSet::difference(overlayPackages, tmpOverlayPackages);
 
-        packages.append(pkg);
+    tmpAddPackages.removeDuplicates();
+    tmpRemovePackages.removeDuplicates();
+    tmpAddPackages.sort();
+    tmpRemovePackages.sort();
+
+
+    // Status update
+    Status::setRepoStateChanged(branchName, name, architecture, "building package database", "", Status::STATE_RUNNING);
+
+    // Update package database
+    if (!updatePackageDatabase(tmpPackages)) {
+        failJob();
+        return;
     }
 
-    // Add sync packages
-    foreach (const QString package, tmpSyncPackages) {
-        Package pkg;
-        pkg.file = package;
-        pkg.name = Global::getNameofPKG(package);
-        pkg.version = Global::getVersionofPKG(package);
-        pkg.link = QString(BOXIT_SYNC_POOL) + "/" + package;
-        pkg.isOverlayPackage = false;
+    {
+        QMutexLocker locker(&mutexJobState);
 
-        // Check if package with same name is already in list - overlay package overwrite sync packages
-        bool found = false;
-        for (int i = 0; i < packages.size(); ++i) {
-            if (pkg.name == packages.at(i).name) {
-                found = true;
-                break;
-            }
+        if (abortRequested) {
+            cancelJob();
+            return;
         }
 
-        if (!found)
-            packages.append(pkg);
+        // Status update
+        Status::setRepoStateChanged(branchName, name, architecture, "waiting for other processes", "", Status::STATE_WAITING);
+
+        waitingCommit = true;
     }
 
+    // Arrive at the commit barrier. The branch queues the commit job as soon as the whole session is prepared.
+    emit threadWaiting(this, threadSessionID);
+}
 
-    // Get a list of all added and removed packages
-    {
-        // Added sync packages
-        foreach (const QString package, tmpSyncPackages) {
-            if (!syncPackages.contains(package))
-                addPackages.append(package);
-        }
 
-        // Removed sync packages
-        foreach (const QString package, syncPackages) {
-            if (!tmpSyncPackages.contains(package))
-                removePackages.append(package);
-        }
 
-        // Added overlay packages
-        foreach (const QString package, tmpOverlayPackages) {
-            if (!overlayPackages.contains(package))
-                addPackages.append(package);
-        }
+void Repo::commitChanges() {
+    CommitJournal::Transaction transaction;
 
-        // Removed overlay packages
-        foreach (const QString package, overlayPackages) {
-            if (!tmpOverlayPackages.contains(package))
-                removePackages.append(package);
-        }
+    // Status update
+    Status::setRepoStateChanged(branchName, name, architecture, "committing changes", "", Status::STATE_RUNNING);
 
-        addPackages.removeDuplicates();
-        removePackages.removeDuplicates();
-        addPackages.sort();
-        removePackages.sort();
+    // Write the commit to the journal first. From now on an interrupted commit is finished by replaying the journal.
+    transaction.id = QString::number(threadSessionID) + "-" + QDateTime::currentDateTimeUtc().toString("yyyyMMddhhmmsszzz");
+    transaction.state = newRandomState();
+    transaction.databaseStamp = fileStamp(newRepoDB);
+    transaction.filesStamp = fileStamp(newRepoFiles);
+    transaction.addOverlayPackages = PackageSet::difference(tmpOverlayPackages, overlayPackages);
+    transaction.removeOverlayPackages = PackageSet::difference(overlayPackages, tmpOverlayPackages);
+    transaction.addSyncPackages = PackageSet::difference(tmpSyncPackages, syncPackages);
+    transaction.removeSyncPackages = PackageSet::difference(syncPackages, tmpSyncPackages);
+
+    if (!journal.append(transaction)) {
+        threadErrorString = "error: failed to write commit journal: " + journal.lastError();
+        goto error;
     }
 
+    // Commit all changes to final destination
+    if (!publishChanges(tmpPackages)) {
+        journal.abort(transaction.id); // Error isn't critical. The replay would finish the commit.
+        goto error;
+    }
+
+    // Lock mutex
+    mutexUpdatingRepoAttributes.lock();
+
+    // Update repository state and packages lists
+    state = transaction.state;
+    overlayPackages = tmpOverlayPackages;
+    syncPackages = tmpSyncPackages;
+    tmpOverlayPackages.clear();
+    tmpSyncPackages.clear();
 
+    // Removed packages might become orphans. Ignored if the repository isn't counted.
+    PoolReferences::add(poolReferenceEpoch, transaction.addOverlayPackages, transaction.addSyncPackages);
+    PoolReferences::remove(poolReferenceEpoch, transaction.removeOverlayPackages, transaction.removeSyncPackages);
 
-    // Create symlinks
-    if (!applySymlinks(packages, tmpPath, Global::getConfig().repoDir))
-        goto error;
+    // The new database is published
+    database = tmpDatabase;
+    database.setPublished();
+    tmpDatabase.clear();
 
-    // Copy database - error isn't critical
-    if (QFile::exists(path + "/" + repoDB))
-        QFile::copy(path + "/" + repoDB, tmpPath + "/" + repoDB);
+    publishMetadata();
 
-    // Copy database files - error isn't critical
-    if (QFile::exists(path + "/" + repoFiles))
-        QFile::copy(path + "/" + repoFiles, tmpPath + "/" + repoFiles);
+    // Unlock mutex
+    mutexUpdatingRepoAttributes.unlock();
 
-    // Status update
-    Status::setRepoStateChanged(branchName, name, architecture, "building package database", "", Status::STATE_RUNNING);
+    touchCache();
 
-    // Update package database
-    if (!updatePackageDatabase(packages))
+    // The journal keeps the transaction until the state files are flushed on the next checkpoint
+    if (!writeStateFiles())
         goto error;
 
+    // Set new branch state
+    emit requestNewBranchState();
+
     // Status update
-    Status::setRepoStateChanged(branchName, name, architecture, "waiting for other processes", "", Status::STATE_WAITING);
+    Status::setRepoStateChanged(branchName, name, architecture, "finished package commit", "", Status::STATE_SUCCESS);
 
-    // Trigger signal
-    waitingCommit = true;
-    emit threadWaiting(this, threadSessionID);
+    // Send e-mail
+    Status::setRepoCommit(threadUsername, branchName, name, architecture, tmpAddPackages, tmpRemovePackages);
 
-    // Sleep
-    mutexWaitCondition.lock();
-    if (!waitCondition.wait(&mutexWaitCondition)) {
-        threadErrorString = "error: wait condition failed!";
-        goto error;
-    }
+    finishJob();
+    return;
 
-    isCommitting = true;
-    waitingCommit = false;
+error:
+    failJob();
+}
 
 
-    // Status update
-    Status::setRepoStateChanged(branchName, name, architecture, "committing changes", "", Status::STATE_RUNNING);
 
-    // Commit all changes to final destination
-    // First create updated symlinks
+bool Repo::publishChanges(const QList<Package> & packages) {
+    // First create new and updated symlinks
     if (!applySymlinks(packages, path, "../../.."))
-        goto error;
+        return false;
 
-    // Remove old database
-    if (QFile::exists(path + "/" + repoDB) && !QFile::remove(path + "/" + repoDB)) {
-        threadErrorString = "error: failed to remove old database!";
-        goto error;
+    // Publish the new database and database files. Rename is atomic: the old files stay visible until they are replaced.
+    if (QFile::exists(path + "/" + newRepoDB)
+            && rename(QFile::encodeName(path + "/" + newRepoDB).constData(), QFile::encodeName(path + "/" + repoDB).constData()) != 0) {
+        threadErrorString = "error: failed to publish new database!";
+        return false;
     }
 
-    // Remove old database files
-    if (QFile::exists(path + "/" + repoFiles) && !QFile::remove(path + "/" + repoFiles)) {
-        threadErrorString = "error: failed to remove old database files!";
-        goto error;
+    if (QFile::exists(path + "/" + newRepoFiles)
+            && rename(QFile::encodeName(path + "/" + newRepoFiles).constData(), QFile::encodeName(path + "/" + repoFiles).constData()) != 0) {
+        threadErrorString = "error: failed to publish new database files!";
+        return false;
     }
 
-    // Copy database
-    if (!QFile::exists(tmpPath + "/" + repoDB) || !QFile::copy(tmpPath + "/" + repoDB, path + "/" + repoDB)) {
-        threadErrorString = "error: failed to copy new database!";
-        goto error;
+    // Link database
+    if (!linkDatabase(repoDB, repoDBLink)) {
+        threadErrorString = "error: failed to link new database!";
+        return false;
     }
 
-    // Copy database files
-    if (!QFile::exists(tmpPath + "/" + repoFiles) || !QFile::copy(tmpPath + "/" + repoFiles, path + "/" + repoFiles)) {
-        threadErrorString = "error: failed to copy new database files!";
-        goto error;
+    // Link database files
+    if (!linkDatabase(repoFiles, repoFilesLink)) {
+        threadErrorString = "error: failed to link new database files!";
+        return false;
     }
 
-    // Fix file permissions of database
-    Global::fixFilePermission(path + "/" + repoDB);
+    // Remove symlinks of packages which aren't in the database anymore.
+    // This also removes databases of a previously configured compression.
+    if (!removeObsoleteSymlinks(packages, path))
+        return false;
 
-    // Fix file permissions of database files
-    Global::fixFilePermission(path + "/" + repoFiles);
+    return true;
+}
 
-    // Link database
-    if (!symlinkExists(path + "/" + repoDBLink) && !QFile::link(repoDB, path + "/" + repoDBLink)) {
-        threadErrorString = "error: failed to link new database!";
-        goto error;
+
+
+bool Repo::writeStateFiles() {
+    QStringList overlayList, syncList;
+    QString currentState;
+
+    {
+        QMutexLocker locker(&mutexUpdatingRepoAttributes);
+        overlayList = overlayPackages;
+        syncList = syncPackages;
+        currentState = state;
     }
 
-    // Link database files
-    if (!symlinkExists(path + "/" + repoFilesLink) && !QFile::link(repoFiles, path + "/" + repoFilesLink)) {
-        threadErrorString = "error: failed to link new database files!";
-        goto error;
+    // Each state file is replaced atomically. The state is written last:
+    // the replay skips all transactions up to the written state.
+    if (!writePackagesConfig(".overlaypackages", overlayList)) {
+        threadErrorString = "error: failed to save overlay packages!";
+        return false;
     }
 
-    // Lock mutex
-    mutexUpdatingRepoAttributes.lock();
+    if (!writePackagesConfig(".syncpackages", syncList)) {
+        threadErrorString = "error: failed to save sync packages!";
+        return false;
+    }
 
-    // Update repository state
-    if (!setNewRandomState()) {
-        mutexUpdatingRepoAttributes.unlock();
+    if (!updateConfig(currentState)) {
         threadErrorString = "error: failed to update repository state!";
-        goto error;
+        return false;
     }
 
-    // Update packages lists
-    overlayPackages = tmpOverlayPackages;
-    syncPackages = tmpSyncPackages;
-    tmpOverlayPackages.clear();
-    tmpSyncPackages.clear();
+    if (journal.getPendingTransactions() < BOXIT_JOURNAL_CHECKPOINT_INTERVAL)
+        return true;
 
-    // Unlock mutex
-    mutexUpdatingRepoAttributes.unlock();
+    // Checkpoint: flush the renames of all state files at once and truncate the journal.
+    // Their content is already flushed by Global::writeFileAtomic().
+    if (!Global::syncFile(path)
+            || !journal.checkpoint())
+        cerr << "warning: failed to checkpoint commit journal of '" << path.toUtf8().data() << "': " << journal.lastError().toUtf8().data() << endl;
 
-    if (!writePackagesConfig(".overlaypackages", overlayPackages)) {
-        threadErrorString = "error: failed to save overlay packages!";
-        goto error;
+    return true;
+}
+
+
+
+bool Repo::replayJournal() {
+    // Requires a locked mutexUpdatingRepoAttributes and the read config
+    QList<CommitJournal::Transaction> transactions;
+
+    if (!journal.read(transactions)) {
+        cerr << "error: " << journal.lastError().toUtf8().data() << endl;
+        return false;
     }
 
-    if (!writePackagesConfig(".syncpackages", syncPackages)) {
-        threadErrorString = "error: failed to save sync packages!";
-        goto error;
+    // The state files of all transactions up to the current state were written,
+    // because the state is written after the package lists.
+    for (int i = transactions.size() - 1; i >= 0; --i) {
+        if (transactions.at(i).state == state) {
+            transactions = transactions.mid(i + 1);
+            break;
+        }
     }
 
-    // Set new branch state
-    emit requestNewBranchState();
+    if (transactions.isEmpty()) {
+        // Databases of prepared but never committed changes
+        removeNewDatabases();
+        return true;
+    }
 
-    // Status update
-    Status::setRepoStateChanged(branchName, name, architecture, "finished package commit", "", Status::STATE_SUCCESS);
+    // The lists stay locked until they are written back
+    if (!loadPackageLists()) {
+        cerr << "error: failed to read package lists of '" << path.toUtf8().data() << "'!" << endl;
+        return false;
+    }
 
-    // Send e-mail
-    Status::setRepoCommit(threadUsername, branchName, name, architecture, addPackages, removePackages);
+    // Apply all diffs in order. They are idempotent.
+    foreach (const CommitJournal::Transaction transaction, transactions) {
+        foreach (const QString package, transaction.removeOverlayPackages)
+            overlayPackages.removeAll(package);
 
-    emit threadFinished(this, threadSessionID);
-    mutexWaitCondition.unlock();
-    isCommitting = false;
-    threadSessionID = -1;
-    threadUsername.clear();
-    return;
+        foreach (const QString package, transaction.addOverlayPackages) {
+            if (!overlayPackages.contains(package))
+                overlayPackages.append(package);
+        }
+
+        foreach (const QString package, transaction.removeSyncPackages)
+            syncPackages.removeAll(package);
+
+        foreach (const QString package, transaction.addSyncPackages) {
+            if (!syncPackages.contains(package))
+                syncPackages.append(package);
+        }
+
+        state = transaction.state;
+    }
+
+    publishMetadata();
+
+    // Finish publishing the last commit. Its database and database files might still be unpublished.
+    // Other new databases belong to prepared changes which were never committed.
+    if (transactions.last().databaseStamp != fileStamp(newRepoDB))
+        QFile::remove(path + "/" + newRepoDB);
+
+    if (transactions.last().filesStamp != fileStamp(newRepoFiles))
+        QFile::remove(path + "/" + newRepoFiles);
+
+    QList<Package> packages;
+    getPackages(overlayPackages, syncPackages, packages);
+
+    if (!publishChanges(packages)) {
+        cerr << threadErrorString.toUtf8().data() << endl;
+        return false;
+    }
+
+    // Rewrite the state files and checkpoint the journal
+    if (!writePackagesConfig(".overlaypackages", overlayPackages)
+            || !writePackagesConfig(".syncpackages", syncPackages)
+            || !updateConfig(state)
+            || !Global::syncFile(path)) {
+        cerr << "error: failed to write recovered state files of '" << path.toUtf8().data() << "'!" << endl;
+        return false;
+    }
+
+    if (!journal.checkpoint()) {
+        cerr << "error: " << journal.lastError().toUtf8().data() << endl;
+        return false;
+    }
+
+    cout << "recovered " << transactions.size() << " journaled commit(s) of '" << path.toUtf8().data() << "'" << endl;
+
+    return true;
+}
+
+
+
+void Repo::getPackages(const QStringList & overlayList, const QStringList & syncList, QList<Package> & packages) {
+    PackageSet overlaySet(overlayList);
+
+    packages.clear();
+
+    // Add overlay packages
+    foreach (const QString package, overlayList) {
+        Package pkg;
+        pkg.file = package;
+        pkg.name = StringPool::intern(Global::getNameofPKG(package));
+        pkg.version = StringPool::intern(Global::getVersionofPKG(package));
+        pkg.link = StringPool::intern(Global::poolFilePath(BOXIT_OVERLAY_POOL, package));
+        pkg.isOverlayPackage = true;
+
+        packages.append(pkg);
+    }
+
+    // Add sync packages
+    foreach (const QString package, syncList) {
+        Package pkg;
+        pkg.file = package;
+        pkg.name = StringPool::intern(Global::getNameofPKG(package));
+        pkg.version = StringPool::intern(Global::getVersionofPKG(package));
+        pkg.link = StringPool::intern(Global::poolFilePath(BOXIT_SYNC_POOL, package));
+        pkg.isOverlayPackage = false;
+
+        // Overlay packages overwrite sync packages with the same name
+        if (!overlaySet.containsName(pkg.name))
+            packages.append(pkg);
+    }
+}
+
+
+
+void Repo::finishJob() {
+    int sessionID;
+
+    {
+        QMutexLocker locker(&mutexJobState);
+
+        sessionID = threadSessionID;
+        clearJobState();
+    }
+
+    emit threadFinished(this, sessionID);
+}
+
+
+
+void Repo::failJob() {
+    int sessionID;
+
+    // Remove unpublished databases
+    removeNewDatabases();
+    tmpDatabase.clear();
 
-error:
     // Status update
     Status::setRepoStateChanged(branchName, name, architecture, "process failed", threadErrorString, Status::STATE_FAILED);
 
-    mutexWaitCondition.unlock();
+    {
+        QMutexLocker locker(&mutexJobState);
+
+        sessionID = threadSessionID;
+        clearJobState();
+    }
+
+    emit threadFailed(this, sessionID);
+}
+
+
+
+void Repo::cancelJob() {
+    // Requires a locked mutexJobState
+
+    // Remove unpublished databases
+    removeNewDatabases();
+    tmpDatabase.clear();
+
+    clearJobState();
+
+    // Status update
+    Status::setRepoStateChanged(branchName, name, architecture, "process canceled", "Process canceled due to a process failure of another repository process with the same session ID.", Status::STATE_FAILED);
+}
+
+
+
+void Repo::clearJobState() {
+    // Requires a locked mutexJobState
+    running = false;
     waitingCommit = false;
     isCommitting = false;
-    emit threadFailed(this, threadSessionID);
+    abortRequested = false;
     threadSessionID = -1;
     threadUsername.clear();
+    tmpPackages.clear();
+    tmpAddPackages.clear();
+    tmpRemovePackages.clear();
+
+    // The commit is done or failed. Unpin if the session released the lock already.
+    if (lockedSessionID < 0)
+        PoolReferences::unpin(this);
+}
+
+
+
+bool Repo::checkAbortRequested() {
+    QMutexLocker locker(&mutexJobState);
+
+    if (!abortRequested)
+        return false;
+
+    cancelJob();
+
+    return true;
+}
+
+
+
+bool Repo::loadPackageLists() {
+    // Requires a locked mutexUpdatingRepoAttributes
+    if (listsLoaded)
+        return true;
+
+    overlayPackages.clear();
+    syncPackages.clear();
+
+    // Get all overlay packages
+    if (!readPackagesConfig(".overlaypackages", overlayPackages))
+        return false;
+
+    // Get all sync packages if this is a sync repo
+    if (isSyncRepo && !readPackagesConfig(".syncpackages", syncPackages)) {
+        overlayPackages.clear();
+        return false;
+    }
+
+    listsLoaded = true;
+    publishMetadata();
+
+    return true;
+}
+
+
+
+void Repo::loadDatabase() {
+    {
+        QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
+        if (databaseLoaded)
+            return;
+
+        // Kept up to date by each commit until evicted. On failure the commit rebuilds the complete database.
+        // Read it through the database link, the compression might have been changed.
+        database.clear();
+        if (!database.read(path + "/" + repoDBLink))
+            cerr << "warning: failed to read package database of '" << path.toUtf8().data() << "': " << database.lastError().toUtf8().data() << endl;
+
+        databaseLoaded = true;
+        publishMetadata();
+    }
+
+    touchCache();
+}
+
+
+
+qint64 Repo::memorySize() {
+    // Requires a locked mutexUpdatingRepoAttributes
+    qint64 size = database.memorySize();
+
+    // Rough estimate: UTF-16 data and the list and string headers
+    foreach (const QString package, overlayPackages)
+        size += package.size() * 2 + 32;
+
+    foreach (const QString package, syncPackages)
+        size += package.size() * 2 + 32;
+
+    return size;
+}
+
+
+
+bool Repo::evict() {
+    // Called by the repository cache. Never blocks: a busy repository is skipped.
+    if (!mutexUpdatingRepoAttributes.tryLock())
+        return false;
+
+    bool evicted = false;
+
+    // Locked and running repositories work on their lists
+    if (!isLocked()) {
+        overlayPackages.clear();
+        syncPackages.clear();
+        database.clear();
+        listsLoaded = false;
+        databaseLoaded = false;
+        evicted = true;
+        publishMetadata();
+    }
+
+    mutexUpdatingRepoAttributes.unlock();
+
+    return evicted;
+}
+
+
+
+bool Repo::addPoolReferences(const quint64 countEpoch) {
+    QMutexLocker locker(&mutexUpdatingRepoAttributes);
+
+    // Already counted
+    if (poolReferenceEpoch == countEpoch)
+        return true;
+
+    if (listsLoaded) {
+        if (PoolReferences::add(countEpoch, overlayPackages, syncPackages))
+            poolReferenceEpoch = countEpoch;
+
+        return true;
+    }
+
+    // Read the lists without keeping them loaded
+    QStringList overlayList, syncList;
+
+    if (!readPackagesConfig(".overlaypackages", overlayList)
+            || (isSyncRepo && !readPackagesConfig(".syncpackages", syncList)))
+        return false;
+
+    if (PoolReferences::add(countEpoch, overlayList, syncList))
+        poolReferenceEpoch = countEpoch;
+
+    return true;
+}
+
+
+
+void Repo::removePoolReferences() {
+    if (poolReferenceEpoch == 0)
+        return;
+
+    const quint64 countEpoch = poolReferenceEpoch;
+    poolReferenceEpoch = 0;
+
+    // Don't read evicted lists again. The next sweep counts all repositories again.
+    if (listsLoaded)
+        PoolReferences::remove(countEpoch, overlayPackages, syncPackages);
+    else
+        PoolReferences::invalidate(countEpoch);
+}
+
+
+
+Repo::MetadataPtr Repo::currentMetadata() {
+    QMutexLocker locker(&mutexMetadata);
+    return metadata;
+}
+
+
+
+void Repo::publishMetadata() {
+    // Requires a locked mutexUpdatingRepoAttributes
+    Repo::Metadata *snapshot = new Repo::Metadata();
+    snapshot->name = name;
+    snapshot->architecture = architecture;
+    snapshot->state = state;
+    snapshot->isSyncRepo = isSyncRepo;
+    snapshot->packagesLoaded = listsLoaded;
+    snapshot->memorySize = memorySize();
+
+    // The lists are implicitly shared with the working copies
+    if (listsLoaded) {
+        snapshot->overlayPackages = overlayPackages;
+        snapshot->syncPackages = syncPackages;
+    }
+
+    // Swap the pointer. Readers of the old snapshot keep it alive.
+    Repo::MetadataPtr published(snapshot);
+
+    QMutexLocker locker(&mutexMetadata);
+    metadata.swap(published);
+}
+
+
+
+void Repo::touchCache() {
+    RepoCache::touch(this, currentMetadata()->memorySize);
 }
 
 
@@ -461,103 +955,76 @@ bool Repo::readConfig() {
 }
 
 
-bool Repo::updateConfig() {
-    QFile file(path + "/" + BOXIT_DB_CONFIG);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
-        return false;
-
-    QTextStream out(&file);
+bool Repo::updateConfig(const QString state) {
+    QString data;
+    QTextStream out(&data);
     out << "###\n### BoxIt Repository Config\n###\n";
     out << "\nstate=" << state;
     out << "\nsync=" << QString::number((int)isSyncRepo);
+    out.flush();
 
-    file.close();
-    return true;
+    return Global::writeFileAtomic(path + "/" + BOXIT_DB_CONFIG, data.toUtf8());
 }
 
 
 
 bool Repo::readPackagesConfig(const QString fileName, QStringList & packages) {
-    packages.clear();
-
-    QFile file(path + "/" + fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-        return false;
-
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (line.isEmpty())
-            continue;
-
-        packages.append(line);
-    }
-
-    file.close();
-
-    return true;
+    return PackageListFile::read(path + "/" + fileName, packages);
 }
 
 
 
 bool Repo::writePackagesConfig(const QString fileName, const QStringList & packages) {
-    QFile file(path + "/" + fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
-        return false;
-
-    QTextStream out(&file);
-    foreach (const QString package, packages)
-        out << package << "\n";
-
-    file.close();
-
-    return true;
+    return PackageListFile::write(path + "/" + fileName, packages);
 }
 
 
 
 bool Repo::applySymlinks(const QList<Package> & packages, const QString path, const QString rootLink) {
-    // List of local files in path
-    QStringList localFiles = QDir(path).entryList(QDir::Files | QDir::System | QDir::NoDotAndDotDot, QDir::Name);
-
-    // Remove all files and symlinks
-    foreach (const QString file, localFiles) {
-        // Skip database (files) and database (files) link
-        if (file == repoDB || file == repoDBLink || file == repoFiles || file == repoFilesLink)
-            continue;
+    // Read the current files and symlinks of path once
+    QHash<QString, QString> localLinks;
 
-        QString dest = path + "/" + file;
-        QFileInfo info(dest);
-
-        if (info.isFile() && !QFile::remove(dest)) {
-            threadErrorString = "error: failed to remove file '" + dest + "'!";
-            return false;
-        }
-        else if (info.isSymLink() && unlink(dest.toStdString().c_str()) != 0) {
-            threadErrorString = "error: failed to remove symlink '" + dest + "'!";
-            return false;
-        }
+    if (!Global::readDirectoryLinks(path, localLinks)) {
+        threadErrorString = "error: failed to read directory '" + path + "'!";
+        return false;
     }
 
+    // Required symlinks: package and signature
+    QHash<QString, QString> links;
 
-    // Create new symlinks
     for (int i = 0; i < packages.size(); ++i) {
         const Package *package = &packages.at(i);
+        const QString link = rootLink + "/" + package->link;
 
-        QString link = rootLink + "/" + package->link;
-        QString dest = path + "/" + package->file;
+        links.insert(package->file, link);
+        links.insert(package->file + BOXIT_SIGNATURE_ENDING, link + BOXIT_SIGNATURE_ENDING);
+    }
 
-        // Symlink package
-        if (!QFile::link(link, dest)) {
-            threadErrorString = "error: failed to symlink '" + link + "' to '" + dest + "'!";
-            return false;
+
+    // Create new symlinks and retarget changed ones
+    for (QHash<QString, QString>::const_iterator it = links.constBegin(); it != links.constEnd(); ++it) {
+        const QString link = it.value();
+        const QString dest = path + "/" + it.key();
+
+        if (!localLinks.contains(it.key())) {
+            if (!QFile::link(link, dest)) {
+                threadErrorString = "error: failed to symlink '" + link + "' to '" + dest + "'!";
+                return false;
+            }
+
+            continue;
         }
 
-        link += BOXIT_SIGNATURE_ENDING;
-        dest += BOXIT_SIGNATURE_ENDING;
+        if (localLinks.value(it.key()) == link)
+            continue;
+
+        // Replace the existing file or symlink atomically
+        const QByteArray tmpDest = QFile::encodeName(path + "/.boxit_link_" + it.key());
+        unlink(tmpDest.constData());
 
-        // Symlink signature
-        if (!QFile::link(link, dest)) {
+        if (symlink(QFile::encodeName(link).constData(), tmpDest.constData()) != 0
+                || rename(tmpDest.constData(), QFile::encodeName(dest).constData()) != 0) {
+            unlink(tmpDest.constData());
             threadErrorString = "error: failed to symlink '" + link + "' to '" + dest + "'!";
             return false;
         }
@@ -568,161 +1035,172 @@ bool Repo::applySymlinks(const QList<Package> & packages, const QString path, co
 
 
 
-bool Repo::symlinkExists(const QString path) {
-    struct stat info;
+bool Repo::removeObsoleteSymlinks(const QList<Package> & packages, const QString path) {
+    QHash<QString, QString> localLinks;
 
-    return (lstat(path.toStdString().c_str(), &info) == 0);
-}
+    if (!Global::readDirectoryLinks(path, localLinks)) {
+        threadErrorString = "error: failed to read directory '" + path + "'!";
+        return false;
+    }
 
+    QSet<QString> files;
 
+    for (int i = 0; i < packages.size(); ++i) {
+        files.insert(packages.at(i).file);
+        files.insert(packages.at(i).file + BOXIT_SIGNATURE_ENDING);
+    }
 
-bool Repo::updatePackageDatabase(const QList<Package> & packages) {
-    QString dbFile = tmpPath + "/" + repoDB;
-    QStringList packagesToRemove, packagesToAdd;
-    QList<Package> dbPackages;
+    // Remove obsolete files and symlinks
+    QHash<QString, QString>::const_iterator it = localLinks.constBegin();
 
-    if (QFile::exists(dbFile)) {
-        // Create temporary directory
-        QString dbTmpPath = tmpPath + "/.boxit_database_extracted";
+    for (; it != localLinks.constEnd(); ++it) {
+        const QString file = it.key();
 
-        if (QDir(dbTmpPath).exists() && !Global::rmDir(dbTmpPath)) {
-            threadErrorString = "error: failed to remove temporary database path!";
-            return false;
-        }
+        // Skip hidden files, database (files) and database (files) link
+        if (file.startsWith(".") || file == repoDB || file == repoDBLink || file == repoFiles || file == repoFilesLink)
+            continue;
 
-        if (!QDir(dbTmpPath).mkpath(dbTmpPath)) {
-            threadErrorString = "error: failed to create temporary database path!";
-            return false;
-        }
+        if (files.contains(file))
+            continue;
 
-        // Unpack the database file
-        QProcess process;
-        process.setProcessChannelMode(QProcess::MergedChannels);
-        process.setWorkingDirectory(tmpPath);
-        process.start("tar", QStringList() << "-xf" << dbFile << "-C" << dbTmpPath);
+        const QString dest = path + "/" + file;
 
-        if (!process.waitForFinished(60000)) {
-            threadErrorString = "error: archive extract process timeout!";
+        if (unlink(QFile::encodeName(dest).constData()) != 0) {
+            threadErrorString = "error: failed to remove '" + dest + "'!";
             return false;
         }
+    }
 
-        if (process.exitCode() != 0) {
-            threadErrorString = "error: archive extract process failed: " + QString::fromUtf8(process.readAll());
-            return false;
-        }
+    return true;
+}
 
 
-        // Get packages list
-        QStringList tmpList = QDir(dbTmpPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
 
-        // Cleanup
-        Global::rmDir(dbTmpPath);
+void Repo::removeNewDatabases() {
+    // Errors aren't critical
+    if (QFile::exists(path + "/" + newRepoDB))
+        QFile::remove(path + "/" + newRepoDB);
 
+    if (QFile::exists(path + "/" + newRepoFiles))
+        QFile::remove(path + "/" + newRepoFiles);
+}
 
-        // Get packages to remove
-        foreach (const QString package, tmpList) {
-            Package pkg;
-            pkg.name = Global::getNameofPKG(package + "-"); // Add '-' because arch is missing -> getNameofPKG fix
-            pkg.version = Global::getVersionofPKG(package + "-");
-            dbPackages.append(pkg);
 
-            bool found = false;
 
-            for (int i = 0; i < packages.size(); ++i) {
-                const Package *package = &packages.at(i);
+QString Repo::fileStamp(const QString fileName) {
+    struct stat info;
 
-                if (pkg.name == package->name && pkg.version == package->version) {
-                    // Check if this package exists in the sync and overlay pool -> remove and readd it to the database to be sure, that the right checksum is in the db...
-                    if (package->isOverlayPackage && tmpSyncPackages.contains(package->file)) {
-                        packagesToAdd.append(package->file);
-                        break;
-                    }
+    // Size and modification time identify an unpublished database
+    if (stat(QFile::encodeName(path + "/" + fileName).constData(), &info) != 0)
+        return QString();
 
-                    found = true;
-                    break;
-                }
-            }
+    return QString("%1.%2.%3").arg(info.st_size).arg(info.st_mtim.tv_sec).arg(info.st_mtim.tv_nsec);
+}
 
-            if (!found)
-                packagesToRemove.append(pkg.name);
-        }
-    }
 
-    // Get package to add
-    for (int i = 0; i < packages.size(); ++i) {
-        const Package *package = &packages.at(i);
 
-        bool found = false;
+bool Repo::linkDatabase(const QString database, const QString link) {
+    const QString dest = path + "/" + link;
 
-        for (int i = 0; i < dbPackages.size(); ++i) {
-            const Package *dbPackage = &dbPackages.at(i);
+    if (symlinkExists(dest) && Global::getSymlinkTarget(dest) == database)
+        return true;
 
-            if (package->name == dbPackage->name && package->version == dbPackage->version) {
-                found = true;
-                break;
-            }
-        }
+    // Replace the link atomically
+    const QByteArray tmpDest = QFile::encodeName(path + "/.boxit_link_" + link);
+    unlink(tmpDest.constData());
 
-        if (!found)
-            packagesToAdd.append(package->file);
+    if (symlink(QFile::encodeName(database).constData(), tmpDest.constData()) != 0
+            || rename(tmpDest.constData(), QFile::encodeName(dest).constData()) != 0) {
+        unlink(tmpDest.constData());
+        return false;
     }
 
+    return true;
+}
 
-    // Remove old packages from database
-    if (!removePackagesFromDatabase(packagesToRemove))
-        return false;
 
-    // Add new packages to database
-    if (!addPackagesToDatabase(packagesToAdd))
-        return false;
 
-    return true;
+bool Repo::symlinkExists(const QString path) {
+    struct stat info;
+
+    return (lstat(path.toStdString().c_str(), &info) == 0);
 }
 
 
 
-bool Repo::addPackagesToDatabase(const QStringList & packages) {
-    if (packages.isEmpty())
-        return true;
+void Repo::getDatabaseChanges(const QList<RepoDatabase::Entry> & dbEntries, const QList<Package> & packages, const QStringList & syncList,
+                              QStringList & packagesToRemove, QStringList & packagesToAdd) {
+    PackageSet dbPackages, syncPackageSet(syncList), packageSet;
 
-    QProcess process;
-    process.setProcessChannelMode(QProcess::MergedChannels);
-    process.setWorkingDirectory(tmpPath);
-    process.start("repo-add", QStringList() << repoDB <<  packages);
+    packagesToRemove.clear();
+    packagesToAdd.clear();
 
-    if (!process.waitForFinished(-1)) {
-        threadErrorString = "error: add packages to database process failed to finish!";
-        return false;
+    for (int i = 0; i < dbEntries.size(); ++i)
+        dbPackages.insert(dbEntries.at(i).name, dbEntries.at(i).version, dbEntries.at(i).fileName);
+
+    for (int i = 0; i < packages.size(); ++i)
+        packageSet.insert(packages.at(i).name, packages.at(i).version, packages.at(i).file);
+
+    // Get packages to remove
+    for (int i = 0; i < dbEntries.size(); ++i) {
+        const RepoDatabase::Entry *dbPackage = &dbEntries.at(i);
+
+        if (!packageSet.contains(dbPackage->name, dbPackage->version))
+            packagesToRemove.append(dbPackage->name);
     }
 
-    if (process.exitCode() != 0) {
-        threadErrorString = "error: failed to add packages to database: " + QString::fromUtf8(process.readAll());
-        return false;
+    // Get package to add. The links are relative to the repository folder.
+    for (int i = 0; i < packages.size(); ++i) {
+        const Package *package = &packages.at(i);
+
+        // If this package exists in the sync and overlay pool -> readd it to the database to be sure, that the right checksum is in the db...
+        if (!dbPackages.contains(package->name, package->version)
+                || (package->isOverlayPackage && syncPackageSet.containsFile(package->file)))
+            packagesToAdd.append(package->link);
     }
 
-    return true;
+    packagesToAdd.removeDuplicates();
 }
 
 
 
-bool Repo::removePackagesFromDatabase(const QStringList & packages) {
-    if (packages.isEmpty())
-        return true;
+bool Repo::updatePackageDatabase(const QList<Package> & packages) {
+    const QString repoDir = Global::getConfig().repoDir;
+    QStringList packagesToRemove, packagesToAdd;
 
-    QProcess process;
-    process.setProcessChannelMode(QProcess::MergedChannels);
-    process.setWorkingDirectory(tmpPath);
-    process.start("repo-remove", QStringList() << repoDB <<  packages);
+    // Work on a copy of the loaded database. It replaces the loaded one on commit.
+    loadDatabase();
+    tmpDatabase = database;
 
-    if (!process.waitForFinished(-1)) {
-        threadErrorString = "error: remove packages from database process failed to finish!";
+    getDatabaseChanges(tmpDatabase.getEntries(), packages, tmpSyncPackages, packagesToRemove, packagesToAdd);
+
+    // Remove old packages from database
+    foreach (const QString package, packagesToRemove)
+        tmpDatabase.removePackage(package); // Error isn't critical. The entry might already be replaced.
+
+    // Add new packages to database
+    foreach (const QString package, packagesToAdd) {
+        if (!tmpDatabase.addPackage(repoDir + "/" + package)) {
+            threadErrorString = "error: failed to add package to database: " + tmpDatabase.lastError();
+            return false;
+        }
+    }
+
+    // Write the new database and files database next to the current ones. They are published on commit.
+    // Unchanged file lists are taken from the files cache. A cold cache is filled from the current files database.
+    if (!tmpDatabase.write(path + "/" + newRepoDB, path + "/" + newRepoFiles, path + "/" + repoFilesLink)) {
+        threadErrorString = "error: failed to write package database: " + tmpDatabase.lastError();
         return false;
     }
 
-    if (process.exitCode() != 0) {
-        threadErrorString = "error: failed to remove packages from database: " + QString::fromUtf8(process.readAll());
+    // Flush them to disk and set the final file permissions before they get published
+    if (!Global::syncFile(path + "/" + newRepoDB) || !Global::syncFile(path + "/" + newRepoFiles)) {
+        threadErrorString = "error: failed to flush new package database!";
         return false;
     }
 
+    Global::fixFilePermission(path + "/" + newRepoDB);
+    Global::fixFilePermission(path + "/" + newRepoFiles);
+
     return true;
 }
@@ -22,41 +22,81 @@
 #define REPO_H
 
 #include <QCoreApplication>
-#include <QThread>
+#include <QObject>
 #include <QString>
 #include <QList>
 #include <QStringList>
 #include <QCryptographicHash>
 #include <QDateTime>
-#include <QWaitCondition>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QHash>
+#include <QSet>
 #include <iostream>
+#include <stdio.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include "global.h"
 #include "const.h"
 #include "status.h"
+#include "repodatabase.h"
+#include "packageset.h"
+#include "commitscheduler.h"
+#include "commitjournal.h"
+#include "packagelistfile.h"
+#include "repocache.h"
+#include "stringpool.h"
+#include "poolreferences.h"
 
 
 using namespace std;
 
 
-class Repo : public QThread
+class Repo : public QObject
 {
     Q_OBJECT
 public:
+    // Published metadata of a repository. Each change publishes a new snapshot,
+    // which replaces the current one. Readers keep their snapshot as long as they need it.
+    struct Metadata {
+        QString name, architecture, state;
+        bool isSyncRepo, packagesLoaded;
+        QStringList overlayPackages, syncPackages;
+        qint64 memorySize;
+
+        Metadata() {
+            isSyncRepo = false;
+            packagesLoaded = false;
+            memorySize = 0;
+        }
+    };
+
+    typedef QSharedPointer<const Repo::Metadata> MetadataPtr;
+
+    struct Package {
+        QString name, version, file, link;
+        bool isOverlayPackage;
+
+        Package() {
+            isOverlayPackage = false;
+        }
+    };
+
     Repo(const QString branchName, const QString name, const QString architecture, const QString path);
     ~Repo();
 
     bool init();
-    bool setNewRandomState();
     bool adjustPackages(const QStringList & addPackages, const QStringList & removePackages, bool workWithSyncPackage = false);
     bool lock(const int sessionID, const QString username);
     void unlock();
     bool isLocked();
+    bool isRunning();
+    bool waitingForCommit();
     bool commit();
     void abort();
+    bool relinkPackages();
+    bool addPoolReferences(const quint64 countEpoch);
 
     QString getName()           { return name; }
     QString getPath()           { return path; }
@@ -65,55 +105,77 @@ public:
     int getLockedSessionID()    { return lockedSessionID; }
     int getThreadSessionID()    { return threadSessionID; }
     bool isSyncable()           { return isSyncRepo; }
-    bool waitingForCommit()     { return waitingCommit; }
 
-    QString getState()                  { QMutexLocker locker(&mutexUpdatingRepoAttributes); return state; }
-    QStringList getOverlayPackages()    { QMutexLocker locker(&mutexUpdatingRepoAttributes); return overlayPackages; }
-    QStringList getSyncPackages()       { QMutexLocker locker(&mutexUpdatingRepoAttributes); return syncPackages; }
+    Repo::MetadataPtr getMetadata(const bool withPackages = true);
+    QString getState()                  { return currentMetadata()->state; }
+    QStringList getOverlayPackages()    { return getMetadata()->overlayPackages; }
+    QStringList getSyncPackages()       { return getMetadata()->syncPackages; }
 
-public slots:
-    void start();
+    // Commit planning. Public for the benchmark tool.
+    static void getPackages(const QStringList & overlayList, const QStringList & syncList, QList<Package> & packages);
+    static void getDatabaseChanges(const QList<RepoDatabase::Entry> & dbEntries, const QList<Package> & packages, const QStringList & syncList,
+                                   QStringList & packagesToRemove, QStringList & packagesToAdd);
 
 signals:
     void requestNewBranchState();
+    void threadStarted(Repo *repo, int threadSessionID);
     void threadFailed(Repo *repo, int threadSessionID);
     void threadWaiting(Repo *repo, int threadSessionID);
     void threadFinished(Repo *repo, int threadSessionID);
 
-protected:
-    void run();
-
 private:
-    struct Package {
-        QString name, version, file, link;
-        bool isOverlayPackage;
-
-        Package() {
-            isOverlayPackage = false;
-        }
-    };
+    friend class CommitScheduler;
+    friend class RepoCache;
 
-    const QString branchName, name, architecture, path, tmpPath, repoDB, repoDBLink, repoFiles, repoFilesLink;
+    const QString branchName, name, architecture, path, tmpPath, repoDB, repoDBLink, repoFiles, repoFilesLink, newRepoDB, newRepoFiles;
     QString state, lockedUsername, threadUsername, threadErrorString;
     int lockedSessionID, threadSessionID;
-    bool isSyncRepo, waitingCommit, isCommitting;
+    quint64 poolReferenceEpoch;
+    bool isSyncRepo, running, waitingCommit, isCommitting, abortRequested, listsLoaded, databaseLoaded;
     QStringList overlayPackages, syncPackages;
-    QStringList tmpOverlayPackages, tmpSyncPackages;
-    QWaitCondition waitCondition;
-    QMutex mutexWaitCondition, mutexUpdatingRepoAttributes;
+    QStringList tmpOverlayPackages, tmpSyncPackages, tmpAddPackages, tmpRemovePackages;
+    QList<Package> tmpPackages;
+    RepoDatabase database, tmpDatabase;
+    CommitJournal journal;
+    Repo::MetadataPtr metadata;
+    QMutex mutexJobState, mutexUpdatingRepoAttributes, mutexMetadata;
+
+    void start();
+    void prepare();
+    void commitChanges();
+    void finishJob();
+    void failJob();
+    void cancelJob();
+    void clearJobState();
+    bool checkAbortRequested();
+
+    bool loadPackageLists();
+    void loadDatabase();
+    qint64 memorySize();
+    bool evict();
+    void removePoolReferences();
+    Repo::MetadataPtr currentMetadata();
+    void publishMetadata();
+    void touchCache();
 
     bool cleanupTmpDir();
     bool readConfig();
-    bool updateConfig();
+    bool updateConfig(const QString state);
     bool readPackagesConfig(const QString fileName, QStringList & packages);
     bool writePackagesConfig(const QString fileName, const QStringList & packages);
 
     bool applySymlinks(const QList<Package> & packages, const QString path, const QString rootLink);
+    bool removeObsoleteSymlinks(const QList<Package> & packages, const QString path);
+    void removeNewDatabases();
+    QString fileStamp(const QString fileName);
+    QString newRandomState();
+    bool publishChanges(const QList<Package> & packages);
+    bool writeStateFiles();
+    bool replayJournal();
+    bool linkDatabase(const QString database, const QString link);
     bool symlinkExists(const QString path);
 
     bool updatePackageDatabase(const QList<Package> & packages);
-    bool addPackagesToDatabase(const QStringList & packages);
-    bool removePackagesFromDatabase(const QStringList & packages);
 };
 
 #endif // REPO_H
@@ -0,0 +1,73 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repocache.h"
+#include "repo.h"
+
+
+
+QMutex RepoCache::mutex;
+QList<Repo*> RepoCache::recentlyUsed;
+QHash<Repo*, qint64> RepoCache::sizes;
+qint64 RepoCache::budget = 0;
+qint64 RepoCache::usedSize = 0;
+
+
+
+void RepoCache::init() {
+    QMutexLocker locker(&mutex);
+    budget = qint64(Global::getConfig().repoCacheSize) * 1024 * 1024;
+}
+
+
+
+void RepoCache::touch(Repo *repo, const qint64 size) {
+    QMutexLocker locker(&mutex);
+
+    // Mark as most recently used
+    usedSize += size - sizes.value(repo, 0);
+    sizes.insert(repo, size);
+    recentlyUsed.removeOne(repo);
+    recentlyUsed.prepend(repo);
+
+    if (budget <= 0)
+        return;
+
+    // Evict the least recently used repositories. Busy ones are skipped.
+    // The mutex is held while evicting. A repository can't be deleted meanwhile.
+    for (int i = recentlyUsed.size() - 1; i > 0 && usedSize > budget; --i) {
+        Repo *victim = recentlyUsed.at(i);
+
+        if (!victim->evict())
+            continue;
+
+        usedSize -= sizes.take(victim);
+        recentlyUsed.removeAt(i);
+    }
+}
+
+
+
+void RepoCache::remove(Repo *repo) {
+    QMutexLocker locker(&mutex);
+
+    usedSize -= sizes.take(repo);
+    recentlyUsed.removeOne(repo);
+}
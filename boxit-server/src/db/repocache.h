@@ -0,0 +1,53 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPOCACHE_H
+#define REPOCACHE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QHash>
+
+#include "global.h"
+#include "const.h"
+
+class Repo;
+
+
+// Keeps track of the memory used by the loaded package lists and databases of
+// all repositories. Repositories load them on first use and report their size
+// here. The least recently used idle repositories are evicted if the budget
+// set with the repoCacheSize config key is exceeded.
+class RepoCache
+{
+public:
+    static void init();
+    static void touch(Repo *repo, const qint64 size);
+    static void remove(Repo *repo);
+
+private:
+    static QMutex mutex;
+    static QList<Repo*> recentlyUsed;
+    static QHash<Repo*, qint64> sizes;
+    static qint64 budget, usedSize;
+};
+
+#endif // REPOCACHE_H
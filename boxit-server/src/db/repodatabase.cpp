@@ -0,0 +1,777 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repodatabase.h"
+
+
+
+//###
+//### Package read callback
+//###
+
+
+// The package file is read only once: libarchive pulls its data through this
+// callback and the checksums are computed on the same buffers.
+struct PackageReadContext {
+    QFile file;
+    QByteArray buffer;
+    QCryptographicHash md5;
+    sha256_context sha256;
+    bool error;
+
+    PackageReadContext() : md5(QCryptographicHash::Md5) {
+        error = false;
+        sha256_starts(&sha256);
+    }
+
+    qint64 readNext() {
+        buffer.resize(65536);
+        qint64 size = file.read(buffer.data(), buffer.size());
+
+        if (size < 0) {
+            error = true;
+            return -1;
+        }
+
+        md5.addData(buffer.constData(), size);
+        sha256_update(&sha256, (uint8*)buffer.data(), size);
+
+        return size;
+    }
+};
+
+
+
+static ssize_t packageReadCallback(struct archive *, void *clientData, const void **buffer) {
+    PackageReadContext *context = (PackageReadContext*)clientData;
+
+    qint64 size = context->readNext();
+    *buffer = context->buffer.constData();
+
+    return (ssize_t)size;
+}
+
+
+
+
+//###
+//### Database write callbacks
+//###
+
+
+// The uncompressed tar stream is handed to the parallel gzip or zstd writer.
+static ssize_t databaseWriteCallback(struct archive *a, void *clientData, const void *buffer, size_t length) {
+    CompressedFile *file = (CompressedFile*)clientData;
+
+    if (!file->write((const char*)buffer, length)) {
+        archive_set_error(a, EIO, "%s", file->lastError().toUtf8().constData());
+        return -1;
+    }
+
+    return (ssize_t)length;
+}
+
+
+
+static ssize_t fragmentWriteCallback(struct archive *, void *clientData, const void *buffer, size_t length) {
+    ((QByteArray*)clientData)->append((const char*)buffer, length);
+    return (ssize_t)length;
+}
+
+
+
+static int databaseCloseCallback(struct archive *a, void *clientData) {
+    CompressedFile *file = (CompressedFile*)clientData;
+
+    if (!file->close()) {
+        archive_set_error(a, EIO, "%s", file->lastError().toUtf8().constData());
+        return ARCHIVE_FATAL;
+    }
+
+    return ARCHIVE_OK;
+}
+
+
+
+
+//###
+//### Public
+//###
+
+
+RepoDatabase::RepoDatabase()
+{
+}
+
+
+
+bool RepoDatabase::read(const QString dbPath) {
+    entries.clear();
+    errorString.clear();
+
+    // A missing database is an empty database
+    if (!QFile::exists(dbPath))
+        return true;
+
+    struct archive *a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+
+    if (archive_read_open_filename(a, QFile::encodeName(dbPath).constData(), 65536) != ARCHIVE_OK) {
+        errorString = QString("failed to open database '%1': %2").arg(dbPath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    QMap<QString, Entry> dirEntries;
+    struct archive_entry *ae;
+    int ret;
+
+    while ((ret = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+        if (archive_entry_filetype(ae) != AE_IFREG)
+            continue;
+
+        const QString pathname = QString::fromUtf8(archive_entry_pathname(ae));
+        const QString dir = pathname.section("/", 0, 0);
+        const QString member = pathname.section("/", 1, -1);
+        QByteArray data;
+
+        if (!readArchiveData(a, data)) {
+            archive_read_free(a);
+            return false;
+        }
+
+        if (member == BOXIT_DB_DESC_FILE)
+            dirEntries[dir].desc = data;
+        else if (member == "depends")
+            dirEntries[dir].depends = data;
+    }
+
+    if (ret != ARCHIVE_EOF) {
+        errorString = QString("failed to read database '%1': %2").arg(dbPath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    archive_read_free(a);
+
+
+    // Index entries by package name
+    QMap<QString, Entry>::iterator it = dirEntries.begin();
+
+    while (it != dirEntries.end()) {
+        Entry entry = it.value();
+        entry.name = getDescField(entry.desc, "NAME");
+        entry.version = getDescField(entry.desc, "VERSION");
+        entry.fileName = getDescField(entry.desc, "FILENAME");
+
+        // Fallback to the directory name. Add '-' because arch is missing -> getNameofPKG fix
+        if (entry.name.isEmpty() || entry.version.isEmpty()) {
+            entry.name = Global::getNameofPKG(it.key() + "-");
+            entry.version = Global::getVersionofPKG(it.key() + "-");
+        }
+
+        // Share the strings with the package lists
+        entry.name = StringPool::intern(entry.name);
+        entry.version = StringPool::intern(entry.version);
+        entry.fileName = StringPool::intern(entry.fileName);
+
+        entries.insert(entry.name, entry);
+        ++it;
+    }
+
+    return true;
+}
+
+
+
+bool RepoDatabase::addPackage(const QString packagePath) {
+    QMap<QString, QStringList> info;
+    QStringList files;
+    QByteArray md5sum, sha256sum, pgpsig;
+    qint64 csize;
+
+    errorString.clear();
+
+    if (!readPackage(packagePath, info, files, md5sum, sha256sum, csize))
+        return false;
+
+    // Ensure pkgname and pkgver were found
+    if (info.value("pkgname").isEmpty() || info.value("pkgver").isEmpty()) {
+        errorString = QString("invalid package file '%1'!").arg(packagePath);
+        return false;
+    }
+
+    // Get base64'd PGP signature
+    QFile sigFile(packagePath + BOXIT_SIGNATURE_ENDING);
+    if (sigFile.exists()) {
+        if (sigFile.size() > 16384) {
+            errorString = QString("invalid package signature file '%1'!").arg(sigFile.fileName());
+            return false;
+        }
+
+        if (!sigFile.open(QIODevice::ReadOnly)) {
+            errorString = QString("failed to read package signature file '%1'!").arg(sigFile.fileName());
+            return false;
+        }
+
+        QByteArray sig = sigFile.readAll();
+        sigFile.close();
+
+        if (sig.contains("BEGIN PGP SIGNATURE")) {
+            errorString = QString("cannot use armored signatures for packages: '%1'!").arg(sigFile.fileName());
+            return false;
+        }
+
+        pgpsig = sig.toBase64();
+    }
+
+
+    Entry entry;
+    entry.name = StringPool::intern(info.value("pkgname").first());
+    entry.version = StringPool::intern(info.value("pkgver").first());
+    entry.fileName = StringPool::intern(packagePath.split("/", QString::SkipEmptyParts).last());
+    entry.isNew = true;
+
+    // Create desc entry - same field order as repo-add
+    appendDescField(entry.desc, "FILENAME", QStringList() << entry.fileName);
+    appendDescField(entry.desc, "NAME", QStringList() << entry.name);
+    appendDescField(entry.desc, "BASE", info.value("pkgbase"));
+    appendDescField(entry.desc, "VERSION", QStringList() << entry.version);
+    appendDescField(entry.desc, "DESC", info.value("pkgdesc"));
+    appendDescField(entry.desc, "GROUPS", info.value("group"));
+    appendDescField(entry.desc, "CSIZE", QStringList() << QString::number(csize));
+    appendDescField(entry.desc, "ISIZE", info.value("size"));
+    appendDescField(entry.desc, "MD5SUM", QStringList() << QString(md5sum));
+    appendDescField(entry.desc, "SHA256SUM", QStringList() << QString(sha256sum));
+    appendDescField(entry.desc, "PGPSIG", QStringList() << QString(pgpsig));
+    appendDescField(entry.desc, "URL", info.value("url"));
+    appendDescField(entry.desc, "LICENSE", info.value("license"));
+    appendDescField(entry.desc, "ARCH", info.value("arch"));
+    appendDescField(entry.desc, "BUILDDATE", info.value("builddate"));
+    appendDescField(entry.desc, "PACKAGER", info.value("packager"));
+    appendDescField(entry.desc, "REPLACES", info.value("replaces"));
+    appendDescField(entry.desc, "CONFLICTS", info.value("conflict"));
+    appendDescField(entry.desc, "PROVIDES", info.value("provides"));
+    appendDescField(entry.desc, "DEPENDS", info.value("depend"));
+    appendDescField(entry.desc, "OPTDEPENDS", info.value("optdepend"));
+    appendDescField(entry.desc, "MAKEDEPENDS", info.value("makedepend"));
+    appendDescField(entry.desc, "CHECKDEPENDS", info.value("checkdepend"));
+
+    // Create files entry
+    entry.files = "%FILES%\n";
+    foreach (const QString file, files)
+        entry.files += file.toUtf8() + "\n";
+
+    // Replace an existing entry with the same package name
+    entries.insert(entry.name, entry);
+
+    return true;
+}
+
+
+
+bool RepoDatabase::removePackage(const QString packageName) {
+    if (entries.remove(packageName) <= 0) {
+        errorString = QString("package matching '%1' not found!").arg(packageName);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+bool RepoDatabase::write(const QString dbPath, const QString filesDbPath, const QString oldFilesDbPath) {
+    errorString.clear();
+
+    const time_t mtime = time(NULL);
+
+    // Write the package database
+    QScopedPointer<CompressedFile> dbFile(newCompressedFile());
+
+    struct archive *db = openWriter(dbPath, *dbFile);
+    if (!db)
+        return false;
+
+    for (QMap<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        if (!writeEntry(db, it.value(), NULL, mtime)) {
+            archive_write_free(db);
+            return false;
+        }
+    }
+
+    if (!closeWriter(db, dbPath))
+        return false;
+
+    // The files database is assembled from cached fragments
+    if (!updateFilesCache(oldFilesDbPath, mtime))
+        return false;
+
+    return writeFilesDatabase(filesDbPath);
+}
+
+
+
+void RepoDatabase::setPublished() {
+    // File lists of published entries are read from the published files database
+    for (QMap<QString, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        it.value().isNew = false;
+        it.value().files.clear();
+    }
+}
+
+
+
+void RepoDatabase::clear() {
+    entries.clear();
+    errorString.clear();
+}
+
+
+
+qint64 RepoDatabase::memorySize() {
+    qint64 size = 0;
+
+    // Rough estimate: UTF-16 strings, byte arrays and the map node
+    foreach (const Entry entry, entries)
+        size += (entry.name.size() + entry.version.size() + entry.fileName.size()) * 2
+                + entry.desc.size() + entry.depends.size() + entry.files.size() + 128;
+
+    return size;
+}
+
+
+
+//###
+//### Private
+//###
+
+
+QString RepoDatabase::getDescField(const QByteArray & desc, const QString field) {
+    const QByteArray key = "%" + field.toUtf8() + "%\n";
+    int index;
+
+    if (desc.startsWith(key))
+        index = key.size();
+    else if ((index = desc.indexOf("\n" + key)) >= 0)
+        index += key.size() + 1;
+    else
+        return QString();
+
+    int end = desc.indexOf('\n', index);
+    if (end < 0)
+        end = desc.size();
+
+    return QString::fromUtf8(desc.mid(index, end - index)).trimmed();
+}
+
+
+
+void RepoDatabase::appendDescField(QByteArray & desc, const QString field, const QStringList & values) {
+    if (values.isEmpty() || values.first().isEmpty())
+        return;
+
+    desc += "%" + field.toUtf8() + "%\n";
+
+    foreach (const QString value, values)
+        desc += value.toUtf8() + "\n";
+
+    desc += "\n";
+}
+
+
+
+bool RepoDatabase::readPackage(const QString packagePath, QMap<QString, QStringList> & info, QStringList & files, QByteArray & md5sum, QByteArray & sha256sum, qint64 & csize) {
+    PackageReadContext context;
+    context.file.setFileName(packagePath);
+
+    if (!context.file.open(QIODevice::ReadOnly)) {
+        errorString = QString("failed to open package file '%1'!").arg(packagePath);
+        return false;
+    }
+
+    csize = context.file.size();
+
+    struct archive *a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+
+    if (archive_read_open(a, &context, NULL, packageReadCallback, NULL) != ARCHIVE_OK) {
+        errorString = QString("failed to open package file '%1': %2").arg(packagePath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    struct archive_entry *ae;
+    int ret;
+
+    while ((ret = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+        const QString pathname = QString::fromUtf8(archive_entry_pathname(ae));
+
+        if (pathname == ".PKGINFO") {
+            QByteArray data;
+
+            if (!readArchiveData(a, data)) {
+                archive_read_free(a);
+                return false;
+            }
+
+            QStringList lines = QString::fromUtf8(data).split("\n", QString::SkipEmptyParts);
+
+            foreach (const QString line, lines) {
+                if (line.startsWith("#") || !line.contains("="))
+                    continue;
+
+                const QString var = line.section("=", 0, 0).trimmed();
+                const QString val = line.section("=", 1, -1).simplified();
+
+                info[var].append(val);
+            }
+        }
+        else if (!pathname.startsWith(".")) {
+            files.append(pathname);
+        }
+    }
+
+    if (ret != ARCHIVE_EOF || context.error) {
+        errorString = QString("failed to read package file '%1': %2").arg(packagePath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    archive_read_free(a);
+
+
+    // Hash trailing data which isn't consumed by libarchive
+    while (context.readNext() > 0)
+        continue;
+
+    if (context.error) {
+        errorString = QString("failed to read package file '%1'!").arg(packagePath);
+        return false;
+    }
+
+    context.file.close();
+
+    uint8 digest[32];
+    sha256_finish(&context.sha256, digest);
+
+    md5sum = context.md5.result().toHex();
+    sha256sum = QByteArray((const char*)digest, 32).toHex();
+
+    return true;
+}
+
+
+
+bool RepoDatabase::updateFilesCache(const QString oldFilesDbPath, const time_t mtime) {
+    if (!QDir().mkpath(filesCacheDir)) {
+        errorString = QString("failed to create files cache '%1'").arg(filesCacheDir);
+        return false;
+    }
+
+    QHash<QString, QString> missing;
+
+    for (QMap<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const Entry & entry = it.value();
+
+        // Only added packages are read. Their file lists are known.
+        if (entry.isNew) {
+            if (!writeFragment(entry, entry.files, mtime))
+                return false;
+        }
+        else if (!QFile::exists(fragmentPath(entry))) {
+            missing.insert(entryDirectory(entry), it.key());
+        }
+    }
+
+    // Fill the cache from the published files database after a restart
+    if (!missing.isEmpty() && !oldFilesDbPath.isEmpty() && QFile::exists(oldFilesDbPath)
+            && !cacheOldFilesEntries(oldFilesDbPath, missing, mtime))
+        return false;
+
+    // The file lists of the remaining packages are unknown
+    foreach (const QString name, missing) {
+        if (!writeFragment(entries[name], QByteArray("%FILES%\n"), mtime))
+            return false;
+    }
+
+    return true;
+}
+
+
+
+bool RepoDatabase::cacheOldFilesEntries(const QString oldFilesDbPath, QHash<QString, QString> & missing, const time_t mtime) {
+    struct archive *a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+
+    if (archive_read_open_filename(a, QFile::encodeName(oldFilesDbPath).constData(), 65536) != ARCHIVE_OK) {
+        errorString = QString("failed to open files database '%1': %2").arg(oldFilesDbPath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    struct archive_entry *ae;
+    int ret = ARCHIVE_EOF;
+
+    while (!missing.isEmpty() && (ret = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+        if (archive_entry_filetype(ae) != AE_IFREG)
+            continue;
+
+        const QString pathname = QString::fromUtf8(archive_entry_pathname(ae));
+        const QString dir = pathname.section("/", 0, 0);
+
+        if (pathname.section("/", 1, -1) != "files" || !missing.contains(dir))
+            continue;
+
+        QByteArray files;
+
+        if (!readArchiveData(a, files) || !writeFragment(entries[missing.value(dir)], files, mtime)) {
+            archive_read_free(a);
+            return false;
+        }
+
+        missing.remove(dir);
+    }
+
+    if (!missing.isEmpty() && ret != ARCHIVE_EOF) {
+        errorString = QString("failed to read files database '%1': %2").arg(oldFilesDbPath, QString::fromUtf8(archive_error_string(a)));
+        archive_read_free(a);
+        return false;
+    }
+
+    archive_read_free(a);
+
+    return true;
+}
+
+
+
+bool RepoDatabase::writeFragment(const Entry & entry, const QByteArray & files, const time_t mtime) {
+    QByteArray data;
+
+    // Write the tar members of the entry into memory
+    struct archive *a = archive_write_new();
+    archive_write_set_format_pax_restricted(a);
+    archive_write_set_bytes_per_block(a, 0);
+
+    if (archive_write_open(a, &data, NULL, fragmentWriteCallback, NULL) != ARCHIVE_OK) {
+        errorString = QString("failed to create files fragment: %1").arg(QString::fromUtf8(archive_error_string(a)));
+        archive_write_free(a);
+        return false;
+    }
+
+    if (!writeEntry(a, entry, &files, mtime)) {
+        archive_write_free(a);
+        return false;
+    }
+
+    if (archive_write_close(a) != ARCHIVE_OK) {
+        errorString = QString("failed to create files fragment: %1").arg(QString::fromUtf8(archive_error_string(a)));
+        archive_write_free(a);
+        return false;
+    }
+
+    archive_write_free(a);
+
+    // Strip the end of archive marker. The fragments are concatenated.
+    data.chop(BOXIT_TAR_END_SIZE);
+
+    // Replace the fragment atomically
+    const QString path = fragmentPath(entry);
+    QFile file(path + ".tmp");
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+        errorString = QString("failed to write files fragment '%1'").arg(file.fileName());
+        return false;
+    }
+
+    file.close();
+
+    if (rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(path).constData()) != 0) {
+        errorString = QString("failed to write files fragment '%1'").arg(path);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+bool RepoDatabase::writeFilesDatabase(const QString filesDbPath) {
+    QScopedPointer<CompressedFile> filesDb(newCompressedFile());
+    QSet<QString> fragments;
+    QByteArray buffer;
+
+    if (!filesDb->open(filesDbPath)) {
+        errorString = QString("failed to create database '%1': %2").arg(filesDbPath, filesDb->lastError());
+        return false;
+    }
+
+    // Stream the fragments of all entries
+    for (QMap<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        QFile file(fragmentPath(it.value()));
+
+        if (!file.open(QIODevice::ReadOnly)) {
+            errorString = QString("failed to open files fragment '%1'").arg(file.fileName());
+            return false;
+        }
+
+        while (!(buffer = file.read(65536)).isEmpty()) {
+            if (!filesDb->write(buffer.constData(), buffer.size())) {
+                errorString = QString("failed to write database '%1': %2").arg(filesDbPath, filesDb->lastError());
+                return false;
+            }
+        }
+
+        file.close();
+        fragments.insert(QFileInfo(file.fileName()).fileName());
+    }
+
+    // End of archive marker
+    buffer.fill('\0', BOXIT_TAR_END_SIZE);
+
+    if (!filesDb->write(buffer.constData(), buffer.size()) || !filesDb->close()) {
+        errorString = QString("failed to write database '%1': %2").arg(filesDbPath, filesDb->lastError());
+        return false;
+    }
+
+    // Remove fragments of packages which aren't in the database anymore
+    foreach (const QString fileName, QDir(filesCacheDir).entryList(QDir::Files)) {
+        if (!fragments.contains(fileName))
+            QFile::remove(filesCacheDir + "/" + fileName);
+    }
+
+    return true;
+}
+
+
+
+QString RepoDatabase::fragmentPath(const Entry & entry) {
+    // The fragment name changes as soon as the description of the package changes
+    return filesCacheDir + "/" + entryDirectory(entry) + "." + QString(QCryptographicHash::hash(entry.desc, QCryptographicHash::Sha1).toHex());
+}
+
+
+
+bool RepoDatabase::readArchiveData(struct archive *a, QByteArray & data) {
+    char buffer[16384];
+    ssize_t size;
+
+    data.clear();
+
+    while ((size = archive_read_data(a, buffer, sizeof(buffer))) > 0)
+        data.append(buffer, size);
+
+    if (size < 0) {
+        errorString = QString("failed to read archive data: %1").arg(QString::fromUtf8(archive_error_string(a)));
+        return false;
+    }
+
+    return true;
+}
+
+
+
+CompressedFile* RepoDatabase::newCompressedFile() {
+    if (Global::getConfig().zstdDatabases)
+        return new ZstdFile();
+
+    return new ParallelGzip();
+}
+
+
+
+struct archive* RepoDatabase::openWriter(const QString path, CompressedFile & file) {
+    if (!file.open(path)) {
+        errorString = QString("failed to create database '%1': %2").arg(path, file.lastError());
+        return NULL;
+    }
+
+    // Compression is done by the compressed file writer
+    struct archive *a = archive_write_new();
+    archive_write_set_format_pax_restricted(a);
+    archive_write_set_bytes_in_last_block(a, 1);
+
+    if (archive_write_open(a, &file, NULL, databaseWriteCallback, databaseCloseCallback) != ARCHIVE_OK) {
+        errorString = QString("failed to create database '%1': %2").arg(path, QString::fromUtf8(archive_error_string(a)));
+        archive_write_free(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+
+
+bool RepoDatabase::closeWriter(struct archive *a, const QString path) {
+    bool success = (archive_write_close(a) == ARCHIVE_OK);
+
+    if (!success)
+        errorString = QString("failed to write database '%1': %2").arg(path, QString::fromUtf8(archive_error_string(a)));
+
+    archive_write_free(a);
+
+    return success;
+}
+
+
+
+bool RepoDatabase::writeEntry(struct archive *a, const Entry & entry, const QByteArray *files, const time_t mtime) {
+    const QString dir = entryDirectory(entry);
+
+    if (!writeMember(a, dir, QByteArray(), true, mtime)
+            || !writeMember(a, dir + "/" + BOXIT_DB_DESC_FILE, entry.desc, false, mtime))
+        return false;
+
+    if (!entry.depends.isEmpty() && !writeMember(a, dir + "/depends", entry.depends, false, mtime))
+        return false;
+
+    if (files && !writeMember(a, dir + "/files", *files, false, mtime))
+        return false;
+
+    return true;
+}
+
+
+
+bool RepoDatabase::writeMember(struct archive *a, const QString pathname, const QByteArray & data, const bool isDir, const time_t mtime) {
+    struct archive_entry *ae = archive_entry_new();
+
+    archive_entry_set_pathname(ae, QString(isDir ? pathname + "/" : pathname).toUtf8().constData());
+    archive_entry_set_filetype(ae, isDir ? AE_IFDIR : AE_IFREG);
+    archive_entry_set_perm(ae, isDir ? 0755 : 0644);
+    archive_entry_set_size(ae, isDir ? 0 : data.size());
+    archive_entry_set_mtime(ae, mtime, 0);
+
+    bool success = (archive_write_header(a, ae) == ARCHIVE_OK);
+
+    if (success && !isDir && !data.isEmpty())
+        success = (archive_write_data(a, data.constData(), data.size()) == data.size());
+
+    if (!success)
+        errorString = QString("failed to write database entry '%1': %2").arg(pathname, QString::fromUtf8(archive_error_string(a)));
+
+    archive_entry_free(ae);
+
+    return success;
+}
@@ -0,0 +1,111 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPODATABASE_H
+#define REPODATABASE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QScopedPointer>
+#include <QCryptographicHash>
+#include <archive.h>
+#include <archive_entry.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "const.h"
+#include "global.h"
+#include "compressedfile.h"
+#include "parallelgzip.h"
+#include "zstdfile.h"
+#include "stringpool.h"
+
+extern "C" {
+#include "sync/sha256/sha256.h"
+}
+
+
+// In-process reader and writer of pacman repository databases.
+// Replaces the repo-add and repo-remove scripts: package informations are read
+// straight from the package archives and the database and files database are
+// written in one pass without forking any external process.
+// The tar members of each files database entry are kept as a fragment in the
+// files cache directory. The files database is the concatenation of them.
+class RepoDatabase
+{
+public:
+    struct Entry {
+        QString name, version, fileName;
+        QByteArray desc, depends, files;
+        bool isNew;
+
+        Entry() {
+            isNew = false;
+        }
+    };
+
+    RepoDatabase();
+
+    bool read(const QString dbPath);
+    bool addPackage(const QString packagePath);
+    bool removePackage(const QString packageName);
+    bool write(const QString dbPath, const QString filesDbPath, const QString oldFilesDbPath = QString());
+    void setPublished();
+    void clear();
+    qint64 memorySize();
+    void setFilesCacheDir(const QString path)  { filesCacheDir = path; }
+
+    QList<RepoDatabase::Entry> getEntries()     { return entries.values(); }
+    bool contains(const QString packageName)    { return entries.contains(packageName); }
+    QString lastError()                         { return errorString; }
+
+    static QString getDescField(const QByteArray & desc, const QString field);
+
+private:
+    QMap<QString, Entry> entries;
+    QString errorString, filesCacheDir;
+
+    static void appendDescField(QByteArray & desc, const QString field, const QStringList & values);
+    static QString entryDirectory(const Entry & entry) { return entry.name + "-" + entry.version; }
+
+    bool readPackage(const QString packagePath, QMap<QString, QStringList> & info, QStringList & files, QByteArray & md5sum, QByteArray & sha256sum, qint64 & csize);
+    bool updateFilesCache(const QString oldFilesDbPath, const time_t mtime);
+    bool cacheOldFilesEntries(const QString oldFilesDbPath, QHash<QString, QString> & missing, const time_t mtime);
+    bool writeFragment(const Entry & entry, const QByteArray & files, const time_t mtime);
+    bool writeFilesDatabase(const QString filesDbPath);
+    QString fragmentPath(const Entry & entry);
+    bool readArchiveData(struct archive *a, QByteArray & data);
+    CompressedFile* newCompressedFile();
+    struct archive* openWriter(const QString path, CompressedFile & file);
+    bool closeWriter(struct archive *a, const QString path);
+    bool writeEntry(struct archive *a, const Entry & entry, const QByteArray *files, const time_t mtime);
+    bool writeMember(struct archive *a, const QString pathname, const QByteArray & data, const bool isDir, const time_t mtime);
+};
+
+#endif // REPODATABASE_H
@@ -0,0 +1,133 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stringpool.h"
+
+
+
+QMutex StringPool::mutex;
+QSet<QString> StringPool::strings;
+bool StringPool::enabled = true;
+
+
+
+QString StringPool::intern(const QString str) {
+    if (str.isEmpty())
+        return QString();
+
+    if (!enabled)
+        return str;
+
+    QMutexLocker locker(&mutex);
+
+    QSet<QString>::const_iterator it = strings.constFind(str);
+    if (it != strings.constEnd())
+        return *it;
+
+    strings.insert(str);
+
+    return str;
+}
+
+
+
+QString StringPool::intern(const char *data, const int size) {
+    if (size <= 0)
+        return QString();
+
+    if (!enabled)
+        return QString::fromUtf8(data, size);
+
+    // Look up short ASCII strings without allocating a new string.
+    // Everything else has to be decoded first.
+    if (size > BOXIT_STRING_POOL_LOOKUP_SIZE)
+        return intern(QString::fromUtf8(data, size));
+
+    QChar buffer[BOXIT_STRING_POOL_LOOKUP_SIZE];
+
+    for (int i = 0; i < size; ++i) {
+        if ((uchar)data[i] >= 0x80)
+            return intern(QString::fromUtf8(data, size));
+
+        buffer[i] = QLatin1Char(data[i]);
+    }
+
+    const QString key = QString::fromRawData(buffer, size);
+
+    QMutexLocker locker(&mutex);
+
+    QSet<QString>::const_iterator it = strings.constFind(key);
+    if (it != strings.constEnd())
+        return *it;
+
+    // Deep copy. The key points to the stack buffer.
+    const QString str(buffer, size);
+    strings.insert(str);
+
+    return str;
+}
+
+
+
+void StringPool::intern(QStringList & list) {
+    if (!enabled)
+        return;
+
+    QMutexLocker locker(&mutex);
+
+    for (int i = 0; i < list.size(); ++i) {
+        if (list.at(i).isEmpty())
+            continue;
+
+        QSet<QString>::const_iterator it = strings.constFind(list.at(i));
+        if (it != strings.constEnd())
+            list[i] = *it;
+        else
+            strings.insert(list.at(i));
+    }
+}
+
+
+
+int StringPool::squeeze() {
+    QMutexLocker locker(&mutex);
+    int removed = 0;
+
+    // A detached string isn't shared with anyone else anymore
+    QSet<QString>::iterator it = strings.begin();
+    while (it != strings.end()) {
+        if (it->isDetached()) {
+            it = strings.erase(it);
+            ++removed;
+        }
+        else {
+            ++it;
+        }
+    }
+
+    return removed;
+}
+
+
+
+int StringPool::size() {
+    QMutexLocker locker(&mutex);
+    return strings.size();
+}
@@ -0,0 +1,55 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "const.h"
+
+
+// Process-wide table of interned strings. Package file names, names and
+// versions show up in the lists of every branch, in the package databases
+// and in each commit. Interned strings share one implicitly shared copy of
+// their data instead of holding their own allocation.
+// Strings which are only referenced by the table are dropped by squeeze().
+// A disabled pool returns its input, which allows to measure the savings.
+class StringPool
+{
+public:
+    static void setEnabled(const bool enable)   { enabled = enable; }
+    static QString intern(const QString str);
+    static QString intern(const char *data, const int size);
+    static void intern(QStringList & list);
+    static int squeeze();
+    static int size();
+
+private:
+    static QMutex mutex;
+    static QSet<QString> strings;
+    static bool enabled;
+};
+
+#endif // STRINGPOOL_H
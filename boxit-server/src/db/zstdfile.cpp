@@ -0,0 +1,118 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "zstdfile.h"
+
+
+
+ZstdFile::ZstdFile()
+{
+    context = NULL;
+}
+
+
+
+ZstdFile::~ZstdFile() {
+    if (file.isOpen())
+        file.close();
+
+    if (context)
+        ZSTD_freeCCtx(context);
+}
+
+
+
+bool ZstdFile::open(const QString path) {
+    Global::Config config = Global::getConfig();
+    errorString.clear();
+
+    if (!context)
+        context = ZSTD_createCCtx();
+    else
+        ZSTD_CCtx_reset(context, ZSTD_reset_session_and_parameters);
+
+    if (!context) {
+        errorString = "failed to create zstd context";
+        return false;
+    }
+
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, config.dbCompressionLevel);
+
+    // Fails if the library is built without multithreading support. Compress single threaded then.
+    ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, (config.dbCompressionThreads > 0) ? config.dbCompressionThreads : qMax(1, QThread::idealThreadCount()));
+
+    output.resize(ZSTD_CStreamOutSize());
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorString = QString("failed to open '%1'").arg(path);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+bool ZstdFile::write(const char *data, const qint64 size) {
+    return compress(data, size, ZSTD_e_continue);
+}
+
+
+
+bool ZstdFile::close() {
+    if (!file.isOpen())
+        return errorString.isEmpty();
+
+    bool success = compress(NULL, 0, ZSTD_e_end);
+    file.close();
+
+    return success;
+}
+
+
+
+//###
+//### Private
+//###
+
+
+
+bool ZstdFile::compress(const char *data, const qint64 size, const ZSTD_EndDirective mode) {
+    ZSTD_inBuffer input = { data, (size_t)size, 0 };
+    size_t remaining;
+
+    do {
+        ZSTD_outBuffer out = { output.data(), (size_t)output.size(), 0 };
+
+        remaining = ZSTD_compressStream2(context, &out, &input, mode);
+        if (ZSTD_isError(remaining)) {
+            errorString = QString("failed to compress '%1': %2").arg(file.fileName(), QString(ZSTD_getErrorName(remaining)));
+            return false;
+        }
+
+        if (file.write(output.constData(), out.pos) != (qint64)out.pos) {
+            errorString = QString("failed to write '%1'").arg(file.fileName());
+            return false;
+        }
+    } while ((mode == ZSTD_e_end) ? (remaining != 0) : (input.pos < input.size));
+
+    return true;
+}
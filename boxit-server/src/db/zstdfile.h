@@ -0,0 +1,55 @@
+/*
+ *  BoxIt - Manjaro Linux Repository Management Software
+ *  Roland Singer <roland@manjaro.org>
+ *
+ *  Copyright (C) 2007 Free Software Foundation, Inc.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ZSTDFILE_H
+#define ZSTDFILE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QThread>
+#include <zstd.h>
+
+#include "global.h"
+#include "const.h"
+#include "compressedfile.h"
+
+
+// zstd file writer. Large inputs are compressed by the zstd worker threads
+// if the library is built with multithreading support.
+class ZstdFile : public CompressedFile
+{
+public:
+    ZstdFile();
+    ~ZstdFile();
+
+    bool open(const QString path);
+    bool write(const char *data, const qint64 size);
+    bool close();
+
+private:
+    QFile file;
+    QByteArray output;
+    ZSTD_CCtx *context;
+
+    bool compress(const char *data, const qint64 size, const ZSTD_EndDirective mode);
+};
+
+#endif // ZSTDFILE_H
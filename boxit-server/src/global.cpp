@@ -84,6 +84,25 @@ QByteArray Global::sha1CheckSum(const QString filePath) {
 
 
 
+QString Global::poolShard(QString file) {
+    // A signature is stored next to its package
+    if (file.endsWith(BOXIT_SIGNATURE_ENDING))
+        file.chop(QString(BOXIT_SIGNATURE_ENDING).length());
+
+    return QString(QCryptographicHash::hash(file.toUtf8(), QCryptographicHash::Md5).toHex().left(BOXIT_POOL_SHARD_LENGTH));
+}
+
+
+
+QString Global::poolFileDir(const QString poolPath, const QString file) {
+    if (!config.shardedPool)
+        return poolPath;
+
+    return poolPath + "/" + poolShard(file);
+}
+
+
+
 bool Global::sendMemoEMail(const QString mailPrefixMessage, const QList<RepoChanges> & repoChanges) {
     QStringList attachments;
     const QString tmpPath = QString(BOXIT_STATUS_TMP) + "/" + QString::number(qrand()) + "_" + QDateTime::currentDateTime().toString(Qt::ISODate);
@@ -279,6 +298,107 @@ bool Global::copyDir(const QString src, const QString dst, const bool hidden) {
 
 
 
+bool Global::cloneDir(const QString src, const QString dst, const QStringList & linkEndings) {
+    // Copy-on-write copy of src including hidden files.
+    // Files are reflinked if the file system supports it. Files ending with one of
+    // linkEndings are hardlinked otherwise: they must only be replaced by rename.
+    QHash<QString, QString> entries;
+
+    if (!readDirectoryLinks(src, entries))
+        return false;
+
+    if (QDir().exists(dst))
+        rmDir(dst);
+
+    if (!QDir().mkpath(dst))
+        return false;
+
+    // Keep same folder permission
+    preserveDirectoryPermission(src, dst); // Error isn't critical
+
+
+    bool success = true;
+    const QByteArray encodedDst = QFile::encodeName(dst);
+
+    // Clone symlinks straight from the directory scan and all other files
+    QHash<QString, QString>::const_iterator it = entries.constBegin();
+    while (it != entries.constEnd()) {
+        const QString file = it.key();
+
+        if (!it.value().isNull()) {
+            if (symlink(QFile::encodeName(it.value()).constData(), QByteArray(encodedDst + "/" + QFile::encodeName(file)).constData()) != 0)
+                success = false;
+        }
+        else {
+            bool allowLink = false;
+
+            foreach (const QString ending, linkEndings) {
+                if (file.endsWith(ending)) {
+                    allowLink = true;
+                    break;
+                }
+            }
+
+            if (!cloneFile(src + "/" + file, dst + "/" + file, allowLink))
+                success = false;
+        }
+
+        ++it;
+    }
+
+    // Clone subdirectories
+    QStringList dirs = QDir(src).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden, QDir::Name);
+
+    foreach (const QString dir, dirs) {
+        if (!cloneDir(src + "/" + dir, dst + "/" + dir, linkEndings))
+            success = false;
+    }
+
+    return success;
+}
+
+
+
+bool Global::cloneFile(const QString src, const QString dst, const bool allowLink) {
+    const QByteArray srcPath = QFile::encodeName(src);
+    const QByteArray dstPath = QFile::encodeName(dst);
+
+#ifdef FICLONE
+    // Share the data blocks with a reflink
+    int in = open(srcPath.constData(), O_RDONLY);
+
+    if (in >= 0) {
+        struct stat info;
+        int out = -1;
+
+        if (fstat(in, &info) == 0)
+            out = open(dstPath.constData(), O_WRONLY | O_CREAT | O_EXCL, info.st_mode & 07777);
+
+        if (out >= 0) {
+            bool cloned = (ioctl(out, FICLONE, in) == 0);
+            close(out);
+
+            if (cloned) {
+                close(in);
+                return true;
+            }
+
+            unlink(dstPath.constData());
+        }
+
+        close(in);
+    }
+#endif
+
+    // Fallback to a hardlink if allowed
+    if (allowLink && link(srcPath.constData(), dstPath.constData()) == 0)
+        return true;
+
+    return QFile::copy(src, dst);
+}
+
+
+
 QString Global::getSymlinkTarget(const QString symlink) {
     char buf[1024];
     ssize_t len;
@@ -293,6 +413,124 @@ QString Global::getSymlinkTarget(const QString symlink) {
 
 
 
+bool Global::readDirectoryLinks(const QString path, QHash<QString, QString> & links) {
+    // Read all non-directory entries of path with a single directory scan.
+    // Symlinks are mapped to their target, all other entries to a null string.
+    links.clear();
+
+    const QByteArray encodedPath = QFile::encodeName(path);
+    DIR *dir = opendir(encodedPath.constData());
+    if (!dir)
+        return false;
+
+    struct dirent *ent;
+    char buf[4096];
+
+    while ((ent = readdir(dir)) != NULL) {
+        const QByteArray encodedName(ent->d_name);
+        if (encodedName == "." || encodedName == "..")
+            continue;
+
+        const QByteArray filePath = encodedPath + "/" + encodedName;
+        unsigned char type = ent->d_type;
+
+        // Not all file systems fill in the type
+        if (type == DT_UNKNOWN) {
+            struct stat info;
+            if (lstat(filePath.constData(), &info) != 0)
+                continue;
+
+            if (S_ISLNK(info.st_mode))
+                type = DT_LNK;
+            else if (S_ISDIR(info.st_mode))
+                type = DT_DIR;
+            else
+                type = DT_REG;
+        }
+
+        if (type == DT_DIR)
+            continue;
+
+        QString target;
+
+        if (type == DT_LNK) {
+            ssize_t len = readlink(filePath.constData(), buf, sizeof(buf) - 1);
+            if (len < 0)
+                continue;
+
+            buf[len] = '\0';
+            target = QFile::decodeName(buf);
+        }
+
+        links.insert(QFile::decodeName(encodedName), target);
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+
+
+bool Global::syncFile(const QString file) {
+    int fd = open(QFile::encodeName(file).constData(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    bool success = (fsync(fd) == 0);
+    close(fd);
+
+    return success;
+}
+
+
+
+bool Global::writeFileAtomic(const QString file, const QByteArray & data) {
+    const QString tmpFile = file + ".boxit_new";
+
+    // Write a new file and replace the old one. Readers see either the old or the new content.
+    // The content is flushed before the rename, otherwise a crash might leave an empty file
+    // behind the new name. The rename itself is durable once the directory is synced.
+    QFile out(tmpFile);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    if (out.write(data) != data.size() || !out.flush() || fdatasync(out.handle()) != 0) {
+        out.close();
+        out.remove();
+        return false;
+    }
+
+    out.close();
+
+    if (rename(QFile::encodeName(tmpFile).constData(), QFile::encodeName(file).constData()) != 0) {
+        QFile::remove(tmpFile);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+qint64 Global::residentMemory() {
+    // Resident set size in kB. Returns -1 if it isn't available.
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (line.startsWith("VmRSS:"))
+            return line.section(" ", 1, 1, QString::SectionSkipEmpty).toLongLong();
+    }
+
+    return -1;
+}
+
+
+
 bool Global::fixFilePermission(const QString file) {
     return setFilePermission(file, S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IROTH | S_IXGRP | S_IXOTH);
 }
@@ -338,15 +576,30 @@ Global::Config Global::getConfig() {
 
 
 
+void Global::setConfig(const Config & newConfig) {
+    config = newConfig;
+}
+
+
+
 bool Global::readConfig() {
     // Cleanup
     config.salt.clear();
     config.repoDir.clear();
     config.syncPoolDir.clear();
     config.overlayPoolDir.clear();
+    config.poolObjectsDir.clear();
     config.sslCertificate.clear();
     config.sslKey.clear();
     config.mailingListEMails.clear();
+    config.commitWorkers = BOXIT_DEFAULT_COMMIT_WORKERS;
+    config.prepareJobsPerDevice = BOXIT_DEFAULT_PREPARE_JOBS_PER_DEVICE;
+    config.dbCompressionThreads = 0;
+    config.dbCompressionLevel = BOXIT_DEFAULT_DB_COMPRESSION_LEVEL;
+    config.zstdDatabases = false;
+    config.repoCacheSize = BOXIT_DEFAULT_REPO_CACHE_SIZE;
+    config.poolObjects = false;
+    config.shardedPool = false;
 
     // Read config
     QFile file(BOXIT_SERVER_CONFIG);
@@ -379,9 +632,63 @@ bool Global::readConfig() {
         else if (arg1 == "mailinglistemail") {
             config.mailingListEMails.append(arg2);
         }
+        else if (arg1 == "commitworkers") {
+            bool ok;
+            int workers = arg2.toInt(&ok);
+            if (ok && workers > 0)
+                config.commitWorkers = workers;
+        }
+        else if (arg1 == "preparejobsperdevice") {
+            bool ok;
+            int jobs = arg2.toInt(&ok);
+            if (ok && jobs >= 0)
+                config.prepareJobsPerDevice = jobs;
+        }
+        else if (arg1 == "dbcompressionthreads") {
+            bool ok;
+            int threads = arg2.toInt(&ok);
+            if (ok && threads >= 0)
+                config.dbCompressionThreads = threads;
+        }
+        else if (arg1 == "dbcompressionlevel") {
+            bool ok;
+            int level = arg2.toInt(&ok);
+            if (ok && level >= 1 && level <= 19)
+                config.dbCompressionLevel = level;
+            else
+                cerr << "warning: invalid database compression level '" << arg2.toUtf8().data() << "'!" << endl;
+        }
+        else if (arg1 == "dbcompression") {
+            config.zstdDatabases = (arg2.toLower() == "zstd");
+        }
+        else if (arg1 == "repocachesize") {
+            bool ok;
+            int size = arg2.toInt(&ok);
+            if (ok && size >= 0)
+                config.repoCacheSize = size;
+        }
+        else if (arg1 == "poolobjects") {
+            config.poolObjects = (arg2.toLower() == "true");
+        }
+        else if (arg1 == "poolobjectsdir") {
+            config.poolObjectsDir = arg2;
+        }
+        else if (arg1 == "shardedpool") {
+            config.shardedPool = (arg2.toLower() == "true");
+        }
     }
     file.close();
 
+    // The object store isn't published. Mirrors would copy each package twice.
+    if (config.poolObjectsDir.isEmpty() && !config.repoDir.isEmpty())
+        config.poolObjectsDir = QDir::cleanPath(config.repoDir) + BOXIT_POOL_OBJECTS_ENDING;
+
+    // zstd accepts levels up to 19, gzip only up to 9
+    if (!config.zstdDatabases && config.dbCompressionLevel > 9) {
+        cerr << "warning: database compression level " << config.dbCompressionLevel << " is not supported by gzip! Using level 9." << endl;
+        config.dbCompressionLevel = 9;
+    }
+
     if (config.salt.isEmpty() || config.repoDir.isEmpty() || config.sslCertificate.isEmpty() || config.sslKey.isEmpty() || config.mailingListEMails.isEmpty())
         return false;
 
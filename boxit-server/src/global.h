@@ -35,9 +35,15 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QDateTime>
+#include <QHash>
 #include <unistd.h>
+#include <dirent.h>
 #include <iostream>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <stdio.h>
 
 #include "const.h"
 
@@ -48,8 +54,10 @@ class Global
 {
 public:
     struct Config {
-        QString salt, sslCertificate, sslKey, repoDir, syncPoolDir, overlayPoolDir;
+        QString salt, sslCertificate, sslKey, repoDir, syncPoolDir, overlayPoolDir, poolObjectsDir;
         QStringList mailingListEMails;
+        int commitWorkers, prepareJobsPerDevice, dbCompressionThreads, dbCompressionLevel, repoCacheSize;
+        bool zstdDatabases, poolObjects, shardedPool;
     };
 
     struct RepoChanges {
@@ -61,16 +69,26 @@ public:
     static QString getNameofPKG(QString pkg);
     static QString getVersionofPKG(QString pkg);
     static QByteArray sha1CheckSum(const QString filePath);
+    static QString poolShard(QString file);
+    static QString poolFileDir(const QString poolPath, const QString file);
+    static QString poolFilePath(const QString poolPath, const QString file) { return poolFileDir(poolPath, file) + "/" + file; }
     static bool sendMemoEMail(const QString mailPrefixMessage, const QList<RepoChanges> & repoChanges);
     static bool sendMemoEMail(const QString mailMessage, const QStringList attachments);
     static bool sendEMail(const QString subject, const QString to, const QString text, const QStringList attachments);
     static bool rmDir(const QString path, const bool onlyHidden = false, const bool onlyContent = false);
     static bool copyDir(const QString src, const QString dst, const bool hidden = false);
+    static bool cloneDir(const QString src, const QString dst, const QStringList & linkEndings = QStringList());
+    static bool cloneFile(const QString src, const QString dst, const bool allowLink = false);
     static QString getSymlinkTarget(const QString symlink);
+    static bool readDirectoryLinks(const QString path, QHash<QString, QString> & links);
+    static bool syncFile(const QString file);
+    static bool writeFileAtomic(const QString file, const QByteArray & data);
+    static qint64 residentMemory();
     static bool fixFilePermission(const QString file);
     static bool setFilePermission(const QString file, const mode_t mode);
     static bool preserveDirectoryPermission(const QString srcDir, const QString destDir);
     static Config getConfig();
+    static void setConfig(const Config & newConfig);
     static bool readConfig();
 
 private:
@@ -27,6 +27,11 @@
 #include "network/boxitserver.h"
 #include "db/database.h"
 #include "db/status.h"
+#include "db/commitscheduler.h"
+#include "db/parallelgzip.h"
+#include "db/repocache.h"
+#include "db/poolstore.h"
+#include "db/stringpool.h"
 #include "maintimer.h"
 
 using namespace std;
@@ -63,7 +68,8 @@ bool addUser() {
 void printHelp() {
     cout << "\nboxit-server [OPTION]\n" << endl;
     cout << "\t-h/--help\t\tshow help" << endl;
-    cout << "\t--adduser\t\tadd user to database\n" << endl;
+    cout << "\t--adduser\t\tadd user to database" << endl;
+    cout << "\t--migrate-pool\t\tmove the pool files to the configured pool layout\n" << endl;
 }
 
 
@@ -88,17 +94,45 @@ int main(int argc, char *argv[])
         else
             return 1;
     }
+    else if (app.arguments().contains("--migrate-pool")) {
+        // Run it while the server is stopped
+        CommitScheduler::init();
+        ParallelGzip::init();
+        RepoCache::init();
+
+        if (!PoolStore::init() || !Database::migratePools()) {
+            cerr << "error: failed to migrate the pool!" << endl;
+            return 1;
+        }
+
+        cout << "migrated the pool!" << endl;
+        return 0;
+    }
     else if (app.arguments().contains("-h") || app.arguments().contains("--help")) {
         printHelp();
         return 0;
     }
 
 
+    // Initialize the commit and database compression workers and the repository cache
+    CommitScheduler::init();
+    ParallelGzip::init();
+    RepoCache::init();
+
+    if (!PoolStore::init()) {
+        cerr << "error: failed to initialize pool object store!" << endl;
+        return 1;
+    }
+
     // Initialize repositories
     cout << "initializing repositories..." << endl;
-    Database::init();
+    if (!Database::init())
+        return 1;
+
     Status::init();
 
+    cout << "resident memory: " << Global::residentMemory() << " kB, interned strings: " << StringPool::size() << endl;
+
 
     // Start main timer
     mainTimer.start();
@@ -112,5 +146,10 @@ int main(int argc, char *argv[])
     }
 
     cout << "running..." << endl;
-    return app.exec();
+    const int ret = app.exec();
+
+    // Save the pool indexes to skip the pool scan on the next start
+    Database::savePoolIndexes();
+
+    return ret;
 }
@@ -46,6 +46,12 @@ void MainTimer::run() {
         // Set each 10 minutes a new check state
         setNewCheckState();
 
+        // Drop interned strings of removed packages
+        StringPool::squeeze();
+
+        // Persist changed pool indexes
+        Database::savePoolIndexes();
+
         // Run this each 3 hours
         if (minutes >= 180) {
             Database::removeOrphanPoolFiles();
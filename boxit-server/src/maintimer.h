@@ -32,6 +32,7 @@
 #include "global.h"
 #include "const.h"
 #include "db/database.h"
+#include "db/stringpool.h"
 
 
 class MainTimer : public QThread
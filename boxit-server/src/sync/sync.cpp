@@ -19,6 +19,7 @@
  */
 
 #include "sync.h"
+#include "db/database.h"
 
 
 Sync::Sync(QObject *parent) :
@@ -53,12 +54,17 @@ void Sync::abort() {
 
     // Unlock all locked repositories by this session ID
     if (branch) {
+        QWriteLocker locker(&branch->rwLock);
+
         for (int i = 0; i < branch->repos.size(); ++i) {
             Repo *repo = branch->repos[i];
 
             if (repo->getLockedSessionID() == sessionID)
                 repo->unlock();
         }
+
+        // Seal the commit barrier of this session
+        branch->sealCommitSession(sessionID);
     }
 }
 
@@ -72,6 +78,8 @@ int Sync::start(const QString username, Branch *branch) {
     this->branch = branch;
     this->sessionID = Global::getNewUniqueSessionID();
 
+    QWriteLocker locker(&branch->rwLock);
+
     // Check if a repository is already locked
     for (int i = 0; i < branch->repos.size(); ++i) {
         if (branch->repos[i]->isLocked())
@@ -94,6 +102,8 @@ int Sync::start(const QString username, Branch *branch) {
         return -1;
     }
 
+    locker.unlock();
+
     QThread::start();
 
     return this->sessionID;
@@ -110,9 +120,6 @@ void Sync::run() {
     // Update state
     Status::setBranchStateChanged(branch->name, "synchronizing packages", "", Status::STATE_RUNNING);
 
-    // Wait a little to be sure the remote client is ready
-    sleep(2);
-
     QList<Package> downloadPackages;
     QList<SyncRepo> syncRepos;
     bool noCommits = true;
@@ -143,21 +150,9 @@ void Sync::run() {
 
         QStringList repoSyncPackages = repo->getSyncPackages();
 
-        // Get packages to add
-        foreach (const QString package, dbPackages) {
-            if (repoSyncPackages.contains(package))
-                continue;
-
-            syncRepo.addPackages.append(package);
-        }
-
-        // Get packages to remove
-        foreach (const QString package, repoSyncPackages) {
-            if (dbPackages.contains(package))
-                continue;
-
-            syncRepo.removePackages.append(package);
-        }
+        // Get packages to add and to remove
+        syncRepo.addPackages = PackageSet::difference(dbPackages, repoSyncPackages);
+        syncRepo.removePackages = PackageSet::difference(repoSyncPackages, dbPackages);
 
         // Add to list
         syncRepos.append(syncRepo);
@@ -188,6 +183,8 @@ void Sync::run() {
     }
 
     // Unlock all locked repositories by this session ID
+    branch->rwLock.lockForWrite();
+
     for (int i = 0; i < branch->repos.size(); ++i) {
         Repo *repo = branch->repos[i];
 
@@ -195,6 +192,10 @@ void Sync::run() {
             repo->unlock();
     }
 
+    // Seal the commit barrier of this session. All started repositories commit together.
+    branch->sealCommitSession(sessionID);
+    branch->rwLock.unlock();
+
     // Update state
     Status::setBranchStateChanged(branch->name, "finished synchronization", "", Status::STATE_SUCCESS);
 
@@ -208,6 +209,8 @@ void Sync::run() {
 error:
 
     // Unlock all locked repositories by this session ID
+    branch->rwLock.lockForWrite();
+
     for (int i = 0; i < branch->repos.size(); ++i) {
         Repo *repo = branch->repos[i];
 
@@ -215,6 +218,10 @@ error:
             repo->unlock();
     }
 
+    // Seal the commit barrier of this session. All started repositories commit together.
+    branch->sealCommitSession(sessionID);
+    branch->rwLock.unlock();
+
     // Update state
     Status::setBranchStateChanged(branch->name, "synchronization failed", errorMessage, Status::STATE_FAILED);
 
@@ -238,12 +245,18 @@ bool Sync::downloadSyncPackages(const QList<Package> & downloadPackages) {
         emit status(i + 1, downloadPackages.size());
         Status::setBranchStateChanged(branch->name, "synchronizing packages [" + QString::number(i + 1) + "/" + QString::number(downloadPackages.size()) + "]", "", Status::STATE_RUNNING);
 
-        const QString pkgPath = syncPath + "/" + package->fileName;
+        const QString pkgDir = Global::poolFileDir(syncPath, package->fileName);
+        const QString pkgPath = pkgDir + "/" + package->fileName;
         const QString sigPath = pkgPath + BOXIT_SIGNATURE_ENDING;
 
-        // Download file...
-        if (package->downloadPackage) {
-            if (!downloadFile(package->url + package->fileName, syncPath)) {
+        if (!QDir().mkpath(pkgDir)) {
+            errorMessage = QString("error: failed to create pool directory '%1'!").arg(pkgDir);
+            return false;
+        }
+
+        // Download file... A stored package with the same checksum is linked instead.
+        if (package->downloadPackage && !PoolStore::linkObject(package->sha256sum, pkgPath)) {
+            if (!downloadFile(package->url + package->fileName, pkgDir)) {
                 errorMessage = QString("error: failed to download package '%1'!").arg(package->fileName);
                 return false;
             }
@@ -260,15 +273,19 @@ bool Sync::downloadSyncPackages(const QList<Package> & downloadPackages) {
 
             // Fix file permission
             Global::fixFilePermission(pkgPath);
+
+            // Store the verified package. Error isn't critical.
+            PoolStore::add(pkgPath, package->sha256sum);
         }
 
         // Download signature file...
         if (package->downloadSignature) {
-            if (!downloadFile(package->url + package->fileName + BOXIT_SIGNATURE_ENDING, syncPath)) {
+            if (!downloadFile(package->url + package->fileName + BOXIT_SIGNATURE_ENDING, pkgDir)) {
                 errorMessage = QString("error: failed to download signature of package '%1'!").arg(package->fileName);
 
                 // Remove package again. A signature is always required!
                 QFile::remove(pkgPath);
+                Database::updateSyncPoolFiles(QStringList() << package->fileName);
 
                 return false;
             }
@@ -276,6 +293,9 @@ bool Sync::downloadSyncPackages(const QList<Package> & downloadPackages) {
             // Fix file permission
             Global::fixFilePermission(sigPath);
         }
+
+        // Add the new files to the sync pool index
+        Database::updateSyncPoolFiles(QStringList() << package->fileName << package->fileName + BOXIT_SIGNATURE_ENDING);
     }
 
 
@@ -286,15 +306,14 @@ bool Sync::downloadSyncPackages(const QList<Package> & downloadPackages) {
 
 bool Sync::getDownloadSyncPackages(QString url, const QString repoName, const QStringList & excludeFiles, QList<Package> & downloadPackages, QStringList & dbPackages) {
     QList<Package> packages;
-    const QString syncPath = Global::getConfig().syncPoolDir;
 
     if (!url.endsWith("/"))
         url += "/";
 
     errorMessage.clear();
 
-    // First download the database...
-    if (!downloadFile(url + repoName + BOXIT_DB_ENDING, tmpPath))
+    // First download the database. Use the database link, it points to the database of any compression.
+    if (!downloadFile(url + repoName + BOXIT_DB_LINK_ENDING, tmpPath))
         return false;
 
     // Fill the packages list
@@ -302,7 +321,7 @@ bool Sync::getDownloadSyncPackages(QString url, const QString repoName, const QS
         return false;
 
     // Remove database file again
-    QFile::remove(tmpPath + "/" + repoName + BOXIT_DB_ENDING); // Error isn't important
+    QFile::remove(tmpPath + "/" + repoName + BOXIT_DB_LINK_ENDING); // Error isn't important
 
     // Clean up first
     dbPackages.clear();
@@ -320,12 +339,12 @@ bool Sync::getDownloadSyncPackages(QString url, const QString repoName, const QS
         dbPackages.append(package.fileName);
 
         // Check if file already exists
-        if (QFile::exists(syncPath + "/" + package.fileName))
+        if (Database::syncPoolFileExists(package.fileName))
             package.downloadPackage = false;
         else
             package.downloadPackage = true;
 
-        if (QFile::exists(syncPath + "/" + package.fileName + BOXIT_SIGNATURE_ENDING))
+        if (Database::syncPoolFileExists(package.fileName + BOXIT_SIGNATURE_ENDING))
             package.downloadSignature = false;
         else
             package.downloadSignature = true;
@@ -374,82 +393,37 @@ bool Sync::downloadFile(const QString url, const QString destPath) {
 
 
 bool Sync::fillPackagesList(const QString repoName, QList<Package> & packages) {
-    QString dbPath = tmpPath + "/.db";
-
-    // Create working folder
-    if ((QDir(dbPath).exists() && !Global::rmDir(dbPath))) {
-        errorMessage = "error: failed to remove folder '" + dbPath + "'";
-        return false;
-    }
-
-    if (!QDir().mkpath(dbPath)) {
-        errorMessage = "error: failed to create folder '" + dbPath + "'";
-        return false;
-    }
-
+    const QString dbPath = tmpPath + "/" + repoName + BOXIT_DB_LINK_ENDING;
+    RepoDatabase database;
 
-    // Unpack the database file
-    QProcess process;
-    process.setProcessChannelMode(QProcess::MergedChannels);
-    process.setWorkingDirectory(dbPath);
-    process.start("tar", QStringList() << "-xf" << tmpPath + "/" + repoName + BOXIT_DB_ENDING << "-C" << dbPath);
-
-    if (!process.waitForFinished(60000)) {
-        errorMessage = "error: archive extract process timeout!";
+    if (!QFile::exists(dbPath)) {
+        errorMessage = "error: database file '" + dbPath + "' is missing!";
         return false;
     }
 
-    if (process.exitCode() != 0) {
-        errorMessage = "error: archive extract process failed: " + QString(process.readAll());
+    // Read the database file. The compression (gzip, xz, zstd) is detected automatically.
+    if (!database.read(dbPath)) {
+        errorMessage = "error: " + database.lastError();
         return false;
     }
 
-
     // Fill packages list
     packages.clear();
-    QStringList list = QDir(dbPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
-
-    for (int i = 0; i < list.size(); ++i) {
-        QString path = dbPath + "/" + list.at(i) + "/" + BOXIT_DB_DESC_FILE;
-
-        // Read config if exist
-        QFile file(path);
-        if (!file.exists())
-            continue;
-
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            errorMessage = QString("error: failed to read database file '%1'!").arg(path);
-            return false;
-        }
 
+    foreach (const RepoDatabase::Entry entry, database.getEntries()) {
         Package package;
-
-        QTextStream in(&file);
-        while (!in.atEnd()) {
-            QString nextLine, line = in.readLine().trimmed();
-            if (line.isEmpty() || in.atEnd() || (nextLine = in.readLine().trimmed()).isEmpty())
-                continue;
-
-            if (line == "%NAME%")
-                package.packageName = nextLine;
-            else if (line == "%FILENAME%")
-                package.fileName = nextLine;
-            else if (line == "%SHA256SUM%")
-                package.sha256sum = nextLine;
-        }
-        file.close();
+        package.packageName = entry.name;
+        package.fileName = entry.fileName;
+        package.sha256sum = RepoDatabase::getDescField(entry.desc, "SHA256SUM");
 
         if (package.packageName.isEmpty() || package.fileName.isEmpty() || package.sha256sum.isEmpty()) {
-            errorMessage = QString("uncomplete desc file '%1'!").arg(path);
+            errorMessage = QString("uncomplete desc entry '%1' in database '%2'!").arg(entry.name, dbPath);
             return false;
         }
 
         packages.append(package);
     }
 
-    // Cleanup
-    Global::rmDir(dbPath); // Error isn't important...
-
     return true;
 }
 
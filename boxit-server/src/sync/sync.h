@@ -40,7 +40,10 @@
 #include "sha256/cryptsha256.h"
 #include "db/branch.h"
 #include "db/repo.h"
+#include "db/repodatabase.h"
+#include "db/packageset.h"
 #include "db/status.h"
+#include "db/poolstore.h"
 
 using namespace std;
 
@@ -22,7 +22,7 @@
 #define CONST_H
 
 
-#define BOXIT_VERSION 6
+#define BOXIT_VERSION 7
 #define BOXIT_PORT 59872
 #define BOXIT_SPLIT_CHAR "|"
 #define BOXIT_SOCKET_MAX_SIZE 50000
@@ -32,7 +32,7 @@
 #define BOXIT_DUMMY_FILE "dummy"
 #define BOXIT_OVERLAY_PACKAGES_CONFIG "overlay_packages"
 #define BOXIT_SYNC_PACKAGES_CONFIG "sync_packages"
-#define BOXIT_PACKAGE_FILTERS "*.pkg.tar.xz *.pkg.tar.gz"
+#define BOXIT_PACKAGE_FILTERS "*.pkg.tar.zst *.pkg.tar.xz *.pkg.tar.gz"
 #define BOXIT_SIGNATURE_ENDING ".sig"
 #define BOXIT_SKIP_ARCHITECTURE_CHECKS "any"
 
@@ -2685,7 +2685,13 @@ bool snapshotBranch() {
         return false;
     }
 
-    cout << ":: Snapshot created." << endl;
+    // The snapshot runs in the background on the server
+    if (!listenOnStatus(true)) {
+        cout << endl << ":: Snapshot failed! Check the process errors..." << endl;
+        return false; // Error messages are printed by the method
+    }
+
+    cout << endl << ":: Snapshot created." << endl;
 
     return true;
 }